@@ -15,12 +15,16 @@ std::string DirectoryOfFilePath(const std::string& filename)
 	else return filename.substr(0, position) + "\\";
 }
 
-AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader)
+AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d)
 {
 	texManager = TexManager;
 	angle = 0.f;
 	alpha = 1.f;
+	color = glm::vec4(1.f);
+	layer = 0;
+	depth = 0.f;
 	prog = shader;
+	b3d = blit3d;
 
 	//determine endianness of architecture
 	unsigned char word[4] = { (unsigned char)0x01, (unsigned char)0x23, (unsigned char)0x45, (unsigned char)0x67 };
@@ -215,7 +219,8 @@ AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, G
 	//Make a path string, so we can load textures from w/e the font file was
 	std::string fontPath = DirectoryOfFilePath(fontfile);
 	textureName = fontPath + textureName;
-	texId = texManager->LoadTexture(textureName);
+	texHandle = texManager->Load(textureName);
+	texId = texManager->TextureId(texHandle);
 
 	verts = new B3D::TVertex[4 * Chars.size()]; //make an array of Textured Vertices
 
@@ -286,7 +291,7 @@ AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, G
 AngelcodeFont::~AngelcodeFont()
 {
 	// free texture
-	texManager->FreeTexture(textureName);
+	texManager->FreeTexture(texHandle);
 
 	// delete VBO when object destroyed
 	glDeleteBuffers(1, &vboId);
@@ -299,6 +304,63 @@ void AngelcodeFont::BlitText(float x, float y, std::string output)
 	dest_x = x;
 	dest_y = y;
 
+	std::unordered_map<int32_t, AngelcodeCharDescriptor>::iterator itr;
+	std::unordered_map<int32_t, float>::iterator itrK;
+
+	int prevLetter = -1; //shouldn't find a kerning pair for this letter on first pass
+
+	if(b3d->drawQueue->active || b3d->spriteBatch->active)
+	{
+		//every glyph goes into the draw queue or the sprite batch, so text costs no extra draw calls
+		float c = cosf(angle);
+		float s = sinf(angle);
+		float penX = 0.f;
+		GLuint tint = B3D::PackColor(color.r, color.g, color.b, color.a * alpha);
+
+		for(unsigned int i = 0; i < output.size(); ++i)
+		{
+			itr = Chars.find(output[i]);
+			if(itr != Chars.end())
+			{
+				AngelcodeCharDescriptor &C = itr->second;
+
+				itrK = C.kerningTable.find(prevLetter);
+				if(itrK != C.kerningTable.end()) penX += itrK->second;
+
+				//center of the glyph quad, relative to the start of the text
+				float localX = penX + C.xOffset + C.width / 2.f;
+				float localY = C.yOffset - C.height / 2.f;
+
+				B3D::DrawCommand command;
+				command.texture = texId;
+				command.halfWidth = C.width / 2.f;
+				command.halfHeight = C.height / 2.f;
+				command.u1 = C.x / scaleW;
+				command.v1 = 1 - C.y / scaleH;
+				command.u2 = (C.x + C.width) / scaleW;
+				command.v2 = 1 - (C.y + C.height) / scaleH;
+				command.x = dest_x + localX * c - localY * s;
+				command.y = dest_y + localX * s + localY * c;
+				command.angle = glm::degrees(angle);
+				command.scaleX = command.scaleY = 1.f;
+				command.color = tint;
+
+				if(b3d->drawQueue->active) b3d->drawQueue->Submit(layer, depth, command);
+				else b3d->spriteBatch->AddSprite(command.texture, command.halfWidth, command.halfHeight,
+					command.u1, command.v1, command.u2, command.v2,
+					command.x, command.y, command.angle, command.scaleX, command.scaleY, command.color);
+
+				penX += C.xAdvance;
+				prevLetter = output[i]; //store this letter for kerning the next one
+			}
+		}
+
+		return;
+	}
+
+	//draw any batched sprites first, so the text ends up on top of them
+	b3d->Flush();
+
 	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
 
 	//bind our texture
@@ -311,16 +373,13 @@ void AngelcodeFont::BlitText(float x, float y, std::string output)
 
 	//send our alpha to the shader
 	prog->setUniform("in_Alpha", alpha);
+	//the Color channel is disabled in our VAO, so the tint comes from the attribute's current value
+	glVertexAttrib4f(3, color.r, color.g, color.b, color.a);
 
 	//send our modelMatrix to the shader
 	prog->setUniform("modelMatrix", modelMatrix);
 	prog->setUniform("in_Scale_X", 1.f); //default scaling
 	prog->setUniform("in_Scale_Y", 1.f); //default scaling
-	
-	std::unordered_map<int32_t, AngelcodeCharDescriptor>::iterator itr;
-	std::unordered_map<int32_t, float>::iterator itrK;
-
-	int prevLetter = -1; //shouldn't find a kerning pair for this letter on first pass
 
 	for(unsigned int i = 0; i < output.size(); ++i)
 	{
@@ -346,6 +405,9 @@ void AngelcodeFont::BlitText(float x, float y, std::string output)
 	// bind with 0, so, switch back to normal pointer operation
 	glBindVertexArray(0);
 
+	//back to untinted for everyone else using the shader
+	glVertexAttrib4f(3, 1.f, 1.f, 1.f, 1.f);
+
 	return;
 }
 
@@ -4,6 +4,9 @@
 	Angelcode bitmap font class.
 	TODO: text format loading? Support for distance fields. Support for packed & non-32bit fonts?
 
+	version 1.8 - added a color tint, which batches like any other glyph
+	version 1.7 - glyphs go into the draw queue when it is active, sorted by layer and depth
+	version 1.6 - glyphs go into the sprite batch when batching is active
 	version 1.5 - now loads the texture file from the same directory as the font data file
 	version 1.4 - fixed character yoffset calculations for Blit3D coordinate system
 	version 1.3 - fixed incorrect verts array index if glyph code is stored more than once in the font file
@@ -56,12 +59,14 @@ private:
 	GLuint vaoId;	//ID of the VAO 		
 
 	GLuint texId; //ID of texture
+	TextureHandle texHandle; //our reference in the texture manager
 	std::string textureName; //filename of the texture
 	TextureManager *texManager; //pointer to the global texture manager
 	glm::mat4 modelMatrix; // Store the model matrix 
 	int modelMatrixLocation; // Store the location of our model matrix in the shader
 	int alphaLocation; //store the location of the alpha variable in the shader
 	GLSLProgram *prog; //our shader for 2d rendering
+	Blit3D *b3d;
 	
 	int16_t ReadShort(int offset, char buffer[]);
 	int32_t ReadInt(int offset, char buffer[]);
@@ -74,11 +79,14 @@ public:
 	GLfloat dest_y;
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha;
+	glm::vec4 color; //tint multiplied with the glyph texels, white by default
+	int layer; //draw queue layer, 0-255, lower layers are drawn first
+	float depth; //draw queue depth within a layer, 0 = front, 1 = back
 
 	void BlitText(float x, float y, std::string output); //draws the string
 	float WidthText(std::string output);//returns the width of the text string, in pixels
 	~AngelcodeFont();
-	AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader);
+	AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d);
 
 };
 
@@ -0,0 +1,143 @@
+#include "Animation.h"
+
+extern logger oLog;
+
+//AnimationClip ----------------------------------------------------------------------
+AnimationClip::AnimationClip(SpriteSheet *spriteSheet, const std::vector<B3D::FrameRect> &rects, float framesPerSecond, B3D::AnimationLoop loopMode)
+{
+	assert(!rects.empty() && "AnimationClip needs at least one frame");
+	assert(framesPerSecond > 0.f);
+
+	sheet = spriteSheet;
+	loop = loopMode;
+
+	double frameTime = 1.0 / framesPerSecond;
+	length = 0.0;
+
+	//each frame is just another region of the shared sheet
+	for(const B3D::FrameRect &r : rects)
+	{
+		frames.push_back(sheet->AddRegion(r.x, r.y, r.width, r.height));
+		length += frameTime;
+		frameEnd.push_back(length);
+	}
+}
+
+void AnimationClip::SetFrameDuration(int frame, double seconds)
+{
+	assert(frame >= 0 && frame < (int)frames.size());
+	assert(seconds > 0.0);
+
+	double previousEnd = frame > 0 ? frameEnd[frame - 1] : 0.0;
+	double change = seconds - (frameEnd[frame] - previousEnd);
+
+	for(int i = frame; i < (int)frameEnd.size(); ++i) frameEnd[i] += change;
+	length += change;
+}
+
+int AnimationClip::FrameAt(double time)
+{
+	int count = (int)frames.size();
+	if(count == 1) return 0;
+
+	switch(loop)
+	{
+	case B3D::AnimationLoop::ONCE:
+		if(time >= length) return count - 1;
+		break;
+
+	case B3D::AnimationLoop::PINGPONG:
+	{
+		//forwards through every frame, then back through the middle ones: 0 1 2 3 2 1 0 1 ...
+		double middle = frameEnd[count - 2] - frameEnd[0]; //time spent in frames 1..count-2
+		time = fmod(time, length + middle);
+		if(time >= length)
+		{
+			double back = time - length;
+			for(int i = count - 2; i > 0; --i)
+			{
+				back -= frameEnd[i] - frameEnd[i - 1];
+				if(back < 0.0) return i;
+			}
+			return 0;
+		}
+	}
+		break;
+
+	default: //LOOP
+		time = fmod(time, length);
+		break;
+	}
+
+	//frames are usually few, a linear search beats anything clever
+	for(int i = 0; i < count; ++i)
+	{
+		if(time < frameEnd[i]) return i;
+	}
+	return count - 1;
+}
+
+//AnimatedSprite ---------------------------------------------------------------------
+AnimatedSprite::AnimatedSprite(AnimationClip *animationClip, Sprite *drawSprite)
+{
+	clip = animationClip;
+	sprite = drawSprite;
+	speed = 1.f;
+	playing = true;
+	Restart();
+}
+
+void AnimatedSprite::Play(AnimationClip *animationClip)
+{
+	assert(animationClip->sheet == sprite->GetSheet() && "AnimatedSprite can only switch to clips on the same spritesheet");
+
+	clip = animationClip;
+	playing = true;
+	Restart();
+}
+
+void AnimatedSprite::Restart(void)
+{
+	time = 0.0;
+	frame = 0;
+	sprite->SetRegion(clip->frames[0]);
+}
+
+bool AnimatedSprite::Finished(void)
+{
+	return clip->loop == B3D::AnimationLoop::ONCE && time >= clip->length;
+}
+
+void AnimatedSprite::Update(double seconds)
+{
+	if(!playing) return;
+
+	time += seconds * speed;
+	if(clip->loop == B3D::AnimationLoop::LOOP && time >= clip->length) time = fmod(time, clip->length);
+
+	//most updates don't reach the end of the current frame
+	if(clip->loop != B3D::AnimationLoop::PINGPONG && time < clip->frameEnd[frame]
+		&& time >= (frame > 0 ? clip->frameEnd[frame - 1] : 0.0)) return;
+
+	int newFrame = clip->FrameAt(time);
+	if(newFrame != frame)
+	{
+		frame = newFrame;
+		sprite->SetRegion(clip->frames[frame]);
+	}
+}
+
+void AnimatedSprite::Blit(void)
+{
+	sprite->Blit();
+}
+
+void AnimatedSprite::Blit(float x, float y)
+{
+	sprite->Blit(x, y);
+}
+
+void AnimatedSprite::Blit(float x, float y, float scale_val_x, float scale_val_y, float alpha_val)
+{
+	sprite->Blit(x, y, scale_val_x, scale_val_y, alpha_val);
+}
@@ -0,0 +1,75 @@
+#pragma once
+/*
+	Spritesheet animation.
+
+	An AnimationClip is a list of frame rects on one spritesheet plus timing. All the frames
+	become regions of the same SpriteSheet, so a clip costs no GL objects of its own: the sheet's
+	single VAO/VBO (and texture) are shared with every other sprite cut from that image.
+
+	An AnimatedSprite is one playing instance of a clip. It draws through a single Sprite and
+	just switches that sprite's region when the frame changes, so it goes through exactly the
+	same paths as Sprite::Blit() (immediate, batched or queued), and only the UVs change.
+
+	Call blit3D->UpdateAnimations(seconds) once from your Update() to advance every
+	AnimatedSprite in one loop, or call Update() on individual ones yourself.
+
+	Create both with Blit3D (MakeAnimationClip(), MakeAnimatedSprite()); a clip must outlive
+	the animated sprites playing it.
+*/
+#include "Blit3D.h"
+#include <vector>
+
+class Blit3D;
+class Sprite;
+class SpriteSheet;
+
+namespace B3D
+{
+	//defined in Blit3D.h, which needs them for MakeAnimationClip()
+	enum class AnimationLoop;
+	class FrameRect;
+}
+
+class AnimationClip
+{
+public:
+	SpriteSheet *sheet;
+	std::vector<int> frames; //region index in the sheet for each frame
+	std::vector<double> frameEnd; //time at which each frame ends, in seconds from the start of the clip
+	double length; //seconds for one pass through the frames
+	B3D::AnimationLoop loop;
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that
+	AnimationClip(SpriteSheet *spriteSheet, const std::vector<B3D::FrameRect> &rects, float framesPerSecond, B3D::AnimationLoop loopMode);
+
+	void SetFrameDuration(int frame, double seconds); //give one frame a different length
+	int FrameAt(double time); //which frame (index into frames) is shown this many seconds into the clip
+};
+
+class AnimatedSprite
+{
+private:
+	AnimationClip *clip;
+	int frame; //index into clip->frames
+	double time; //seconds into the clip
+
+public:
+	Sprite *sprite; //the one sprite we draw with; set its position, angle etc. as usual
+	float speed; //1 = normal speed, 2 = double speed, etc.
+	bool playing;
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that
+	AnimatedSprite(AnimationClip *animationClip, Sprite *drawSprite);
+
+	void Play(AnimationClip *animationClip); //switch clip (must be on the same sheet) and restart
+	void Restart(void);
+	bool Finished(void); //true once a ONCE clip has reached its last frame
+	int GetFrame(void) { return frame; }
+	AnimationClip *GetClip(void) { return clip; }
+
+	void Update(double seconds); //advance the animation
+
+	void Blit(void); //draw the current frame, same as Sprite::Blit()
+	void Blit(float x, float y);
+	void Blit(float x, float y, float scale_val_x, float scale_val_y, float alpha_val);
+};
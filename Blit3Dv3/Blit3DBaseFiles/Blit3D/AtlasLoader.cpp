@@ -0,0 +1,422 @@
+#include "AtlasLoader.h"
+#include "Blit3D.h"
+
+extern logger oLog;
+
+std::string DirectoryOfFilePath(const std::string& filename); //in AngelcodeFont.cpp
+
+//minimal JSON reader, just enough for atlas descriptors -------------------------------
+class JsonValue
+{
+public:
+	enum class Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+	Type type = Type::NUL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> items; //ARRAY
+	std::vector<std::pair<std::string, JsonValue>> members; //OBJECT, in file order
+
+	const JsonValue *Find(const char *key) const
+	{
+		for(const auto &member : members)
+		{
+			if(member.first == key) return &member.second;
+		}
+		return NULL;
+	}
+
+	float Number(const char *key) const
+	{
+		const JsonValue *value = Find(key);
+		return value && value->type == Type::NUMBER ? (float)value->number : 0.f;
+	}
+};
+
+class JsonReader
+{
+private:
+	const char *p;
+	const char *end;
+
+	void SkipSpace(void)
+	{
+		while(p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+	}
+
+	bool Literal(const char *word)
+	{
+		size_t length = strlen(word);
+		if((size_t)(end - p) < length || strncmp(p, word, length) != 0) return false;
+		p += length;
+		return true;
+	}
+
+	static void AppendUtf8(std::string &out, uint32_t code)
+	{
+		if(code < 0x80) out += (char)code;
+		else if(code < 0x800)
+		{
+			out += (char)(0xC0 | (code >> 6));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xE0 | (code >> 12));
+			out += (char)(0x80 | ((code >> 6) & 0x3F));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+	}
+
+	bool ReadString(std::string &out)
+	{
+		if(p >= end || *p != '"') return false;
+		++p;
+
+		while(p < end && *p != '"')
+		{
+			if(*p != '\\')
+			{
+				out += *p++;
+				continue;
+			}
+
+			if(++p >= end) return false;
+			switch(*p++)
+			{
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'u':
+			{
+				if(end - p < 4) return false;
+				uint32_t code = (uint32_t)strtoul(std::string(p, 4).c_str(), NULL, 16);
+				p += 4;
+				AppendUtf8(out, code);
+			}
+				break;
+			default: out += p[-1]; break; //quote, backslash and slash stand for themselves
+			}
+		}
+
+		if(p >= end) return false;
+		++p; //closing quote
+		return true;
+	}
+
+public:
+	JsonReader(const char *text, size_t length) : p(text), end(text + length) {}
+
+	bool Read(JsonValue &value)
+	{
+		SkipSpace();
+		if(p >= end) return false;
+
+		switch(*p)
+		{
+		case '{':
+			value.type = JsonValue::Type::OBJECT;
+			++p;
+			SkipSpace();
+			if(p < end && *p == '}') { ++p; return true; }
+			for(;;)
+			{
+				std::pair<std::string, JsonValue> member;
+				SkipSpace();
+				if(!ReadString(member.first)) return false;
+				SkipSpace();
+				if(p >= end || *p++ != ':') return false;
+				if(!Read(member.second)) return false;
+				value.members.push_back(std::move(member));
+
+				SkipSpace();
+				if(p >= end) return false;
+				if(*p == ',') { ++p; continue; }
+				if(*p++ == '}') return true;
+				return false;
+			}
+
+		case '[':
+			value.type = JsonValue::Type::ARRAY;
+			++p;
+			SkipSpace();
+			if(p < end && *p == ']') { ++p; return true; }
+			for(;;)
+			{
+				value.items.push_back(JsonValue());
+				if(!Read(value.items.back())) return false;
+
+				SkipSpace();
+				if(p >= end) return false;
+				if(*p == ',') { ++p; continue; }
+				if(*p++ == ']') return true;
+				return false;
+			}
+
+		case '"':
+			value.type = JsonValue::Type::STRING;
+			return ReadString(value.string);
+
+		case 't':
+			value.type = JsonValue::Type::BOOLEAN;
+			value.boolean = true;
+			return Literal("true");
+
+		case 'f':
+			value.type = JsonValue::Type::BOOLEAN;
+			return Literal("false");
+
+		case 'n':
+			return Literal("null");
+
+		default:
+		{
+			char *numberEnd = NULL;
+			value.type = JsonValue::Type::NUMBER;
+			value.number = strtod(p, &numberEnd);
+			if(numberEnd == p) return false;
+			p = numberEnd;
+			return true;
+		}
+		}
+	}
+};
+
+//one frame entry, the same in both JSON flavours apart from where the name lives
+static bool ReadJsonFrame(const std::string &name, const JsonValue &entry, std::vector<B3D::AtlasFrame> &frames)
+{
+	const JsonValue *rect = entry.Find("frame");
+	if(rect == NULL || rect->type != JsonValue::Type::OBJECT) return false;
+
+	B3D::AtlasFrame frame;
+	frame.name = name;
+	frame.x = rect->Number("x");
+	frame.y = rect->Number("y");
+	//TexturePacker gives the size of the frame upright, a rotated one lies on the texture with w and h swapped
+	float uprightWidth = rect->Number("w");
+	float uprightHeight = rect->Number("h");
+
+	const JsonValue *rotated = entry.Find("rotated");
+	frame.rotated = rotated && rotated->type == JsonValue::Type::BOOLEAN && rotated->boolean;
+	frame.width = frame.rotated ? uprightHeight : uprightWidth;
+	frame.height = frame.rotated ? uprightWidth : uprightHeight;
+
+	//trimmed frames say so, and their sourceSize is bigger than the frame
+	const JsonValue *trimmed = entry.Find("trimmed");
+	const JsonValue *sourceSize = entry.Find("sourceSize");
+	const JsonValue *spriteSourceSize = entry.Find("spriteSourceSize");
+	frame.trimmed = (trimmed && trimmed->type == JsonValue::Type::BOOLEAN && trimmed->boolean)
+		|| (sourceSize && sourceSize->type == JsonValue::Type::OBJECT
+			&& (sourceSize->Number("w") != uprightWidth || sourceSize->Number("h") != uprightHeight));
+
+	//spriteSourceSize is where the trimmed rect sat in the original image, from its top-left corner
+	frame.offsetX = frame.offsetY = 0.f;
+	if(frame.trimmed && sourceSize && sourceSize->type == JsonValue::Type::OBJECT
+		&& spriteSourceSize && spriteSourceSize->type == JsonValue::Type::OBJECT)
+	{
+		frame.offsetX = spriteSourceSize->Number("x") + uprightWidth / 2.f - sourceSize->Number("w") / 2.f;
+		frame.offsetY = sourceSize->Number("h") / 2.f - (spriteSourceSize->Number("y") + uprightHeight / 2.f);
+	}
+
+	frames.push_back(frame);
+	return true;
+}
+
+static bool ReadJsonAtlas(const std::string &filename, const std::string &text, std::string &imageFile, std::vector<B3D::AtlasFrame> &frames)
+{
+	JsonValue root;
+	JsonReader reader(text.data(), text.size());
+	if(!reader.Read(root) || root.type != JsonValue::Type::OBJECT)
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " is not valid JSON";
+		return false;
+	}
+
+	const JsonValue *meta = root.Find("meta");
+	const JsonValue *image = meta ? meta->Find("image") : NULL;
+	if(image == NULL || image->type != JsonValue::Type::STRING)
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " has no meta.image";
+		return false;
+	}
+	imageFile = image->string;
+
+	const JsonValue *list = root.Find("frames");
+	bool ok = list != NULL;
+
+	if(ok && list->type == JsonValue::Type::OBJECT)
+	{
+		//hash: "name": { "frame": {...} }
+		frames.reserve(list->members.size());
+		for(const auto &member : list->members) ok = ok && ReadJsonFrame(member.first, member.second, frames);
+	}
+	else if(ok && list->type == JsonValue::Type::ARRAY)
+	{
+		//array: { "filename": "name", "frame": {...} }
+		frames.reserve(list->items.size());
+		for(const JsonValue &item : list->items)
+		{
+			const JsonValue *name = item.Find("filename");
+			ok = ok && name != NULL && ReadJsonFrame(name->string, item, frames);
+		}
+	}
+	else ok = false;
+
+	if(!ok) oLog(Level::Severe) << "Atlas file " << filename << " has missing or malformed frames";
+	return ok;
+}
+
+//XML SubTexture lists -----------------------------------------------------------------
+static std::string XmlUnescape(const std::string &value)
+{
+	if(value.find('&') == std::string::npos) return value;
+
+	static const char *entities[][2] = { { "&amp;", "&" }, { "&lt;", "<" }, { "&gt;", ">" }, { "&quot;", "\"" }, { "&apos;", "'" } };
+
+	std::string out;
+	for(size_t i = 0; i < value.size(); ++i)
+	{
+		bool replaced = false;
+		if(value[i] == '&')
+		{
+			for(auto &entity : entities)
+			{
+				size_t length = strlen(entity[0]);
+				if(value.compare(i, length, entity[0]) == 0)
+				{
+					out += entity[1];
+					i += length - 1;
+					replaced = true;
+					break;
+				}
+			}
+		}
+		if(!replaced) out += value[i];
+	}
+	return out;
+}
+
+//finds name="value" (or 'value') inside one tag
+static bool XmlAttribute(const std::string &tag, const char *name, std::string &value)
+{
+	size_t length = strlen(name);
+	size_t position = 0;
+	while((position = tag.find(name, position)) != std::string::npos)
+	{
+		//must be a whole attribute name, not the end of another one
+		bool startsName = position > 0 && isspace((unsigned char)tag[position - 1]);
+		size_t equals = tag.find_first_not_of(" \t\r\n", position + length);
+		position += length;
+		if(!startsName || equals == std::string::npos || tag[equals] != '=') continue;
+
+		size_t quote = tag.find_first_not_of(" \t\r\n", equals + 1);
+		if(quote == std::string::npos || (tag[quote] != '"' && tag[quote] != '\'')) return false;
+		size_t close = tag.find(tag[quote], quote + 1);
+		if(close == std::string::npos) return false;
+
+		value = XmlUnescape(tag.substr(quote + 1, close - quote - 1));
+		return true;
+	}
+	return false;
+}
+
+static bool ReadXmlAtlas(const std::string &filename, const std::string &text, std::string &imageFile, std::vector<B3D::AtlasFrame> &frames)
+{
+	size_t atlasTag = text.find("<TextureAtlas");
+	if(atlasTag == std::string::npos)
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " has no <TextureAtlas> element";
+		return false;
+	}
+
+	std::string tag = text.substr(atlasTag, text.find('>', atlasTag) - atlasTag);
+	if(!XmlAttribute(tag, "imagePath", imageFile))
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " has no imagePath";
+		return false;
+	}
+
+	size_t position = atlasTag;
+	while((position = text.find("<SubTexture", position)) != std::string::npos)
+	{
+		size_t close = text.find('>', position);
+		if(close == std::string::npos) break;
+		tag = text.substr(position, close - position);
+		position = close;
+
+		B3D::AtlasFrame frame;
+		std::string x, y, width, height, rotated, frameX, frameY, frameWidth, frameHeight;
+		if(!XmlAttribute(tag, "name", frame.name) || !XmlAttribute(tag, "x", x) || !XmlAttribute(tag, "y", y)
+			|| !XmlAttribute(tag, "width", width) || !XmlAttribute(tag, "height", height))
+		{
+			oLog(Level::Severe) << "Atlas file " << filename << " has a malformed SubTexture: " << tag;
+			return false;
+		}
+
+		frame.x = (float)atof(x.c_str());
+		frame.y = (float)atof(y.c_str());
+		frame.width = (float)atof(width.c_str());
+		frame.height = (float)atof(height.c_str());
+		//unlike the JSON, the XML rect is already the one on the texture, rotated or not
+		frame.rotated = XmlAttribute(tag, "rotated", rotated) && rotated == "true";
+		float uprightWidth = frame.rotated ? frame.height : frame.width;
+		float uprightHeight = frame.rotated ? frame.width : frame.height;
+
+		//trimmed SubTextures carry the untrimmed size in frameWidth/frameHeight, and in frameX/frameY
+		//minus how much was cut off the left and top
+		frame.trimmed = false;
+		frame.offsetX = frame.offsetY = 0.f;
+		if(XmlAttribute(tag, "frameWidth", frameWidth) && XmlAttribute(tag, "frameHeight", frameHeight))
+		{
+			float fullWidth = (float)atof(frameWidth.c_str());
+			float fullHeight = (float)atof(frameHeight.c_str());
+			float left = XmlAttribute(tag, "frameX", frameX) ? -(float)atof(frameX.c_str()) : 0.f;
+			float top = XmlAttribute(tag, "frameY", frameY) ? -(float)atof(frameY.c_str()) : 0.f;
+
+			frame.trimmed = fullWidth != uprightWidth || fullHeight != uprightHeight;
+			frame.offsetX = left + uprightWidth / 2.f - fullWidth / 2.f;
+			frame.offsetY = fullHeight / 2.f - (top + uprightHeight / 2.f);
+		}
+		frames.push_back(frame);
+	}
+
+	return true;
+}
+
+bool B3D::ReadAtlasFile(const std::string &filename, std::string &imageFile, std::vector<AtlasFrame> &frames)
+{
+	//one read of the whole file, then parse from memory
+	std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+	if(!ifs.is_open())
+	{
+		oLog(Level::Severe) << "Can't open atlas file: " << filename;
+		return false;
+	}
+	std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+	size_t first = text.find_first_not_of(" \t\r\n\xEF\xBB\xBF"); //skip whitespace and a UTF-8 BOM
+	if(first == std::string::npos)
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " is empty";
+		return false;
+	}
+
+	frames.clear();
+	bool ok;
+	if(text[first] == '{') ok = ReadJsonAtlas(filename, text, imageFile, frames);
+	else if(text[first] == '<') ok = ReadXmlAtlas(filename, text, imageFile, frames);
+	else
+	{
+		oLog(Level::Severe) << "Atlas file " << filename << " is neither JSON nor XML";
+		return false;
+	}
+
+	if(!ok) return false;
+
+	//the image sits next to the descriptor
+	imageFile = DirectoryOfFilePath(filename) + imageFile;
+	return true;
+}
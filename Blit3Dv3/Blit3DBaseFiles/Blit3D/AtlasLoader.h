@@ -0,0 +1,50 @@
+#pragma once
+/*
+	Readers for sprite atlas descriptor files.
+
+	Supported formats:
+	- TexturePacker JSON, "hash" flavour: "frames" is an object keyed by frame name
+	- TexturePacker JSON, "array" flavour: "frames" is an array of objects with a "filename"
+	- XML SubTexture lists (TexturePacker/Starling/Sparrow): <TextureAtlas imagePath="...">
+	  with one <SubTexture name="..." x="..." y="..." width="..." height="..."/> per frame
+
+	The format is picked from the first character of the file. The image path in the file is
+	relative to the descriptor, the returned path has the descriptor's directory added.
+
+	Rotated and trimmed frames are supported: AtlasFrame always holds the rect as it lies on the
+	texture, plus the offset that puts a trimmed frame back where it was in the original image.
+
+	Use Blit3D::LoadSpriteAtlas() to turn a descriptor into sprites in one go.
+	AtlasRegion is what TextureAtlas (atlases packed at runtime) hands out for each image.
+*/
+#include <string>
+#include <vector>
+#include "HandlePool.h"
+
+class tex; //TextureManager.h; B3D::Handle<tex> is a TextureHandle
+
+namespace B3D
+{
+	class AtlasFrame
+	{
+	public:
+		std::string name;
+		float x, y, width, height; //rect on the texture, in pixels, as it lies there (rotated frames are turned)
+		bool rotated; //the packer stored the frame turned 90 degrees clockwise
+		bool trimmed; //transparent edges were cut off, so the frame is smaller than the original image
+		float offsetX, offsetY; //center of the trimmed rect relative to the center of the original image, y up; 0 if untrimmed
+	};
+
+	//where a TextureAtlas packed an image: usable wherever a texture name and pixel rect are taken
+	class AtlasRegion
+	{
+	public:
+		std::string texture; //name of the page texture in the TextureManager
+		B3D::Handle<tex> textureHandle; //the same page texture as a TextureHandle; stale until the atlas is built
+		float x, y, width, height; //pixel rect on the page, from the top-left corner, like MakeSprite() takes
+		int page; //-1 if the image couldn't be loaded or is too big for a page
+	};
+
+	//parses the whole file in one pass; returns false (and logs why) if it can't be read or understood
+	bool ReadAtlasFile(const std::string &filename, std::string &imageFile, std::vector<AtlasFrame> &frames);
+}
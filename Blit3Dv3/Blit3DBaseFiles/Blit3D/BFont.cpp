@@ -2,11 +2,12 @@
 
 extern logger oLog;
 
-BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader)
+BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d)
 {
 	//load the texture via the texture manager
 	texManager = TexManager;
-	texId = texManager->LoadTexture(TextureFileName);
+	texHandle = texManager->Load(TextureFileName);
+	texId = texManager->TextureId(texHandle);
 	if(texId == 0)
 	{
 		oLog(Level::Severe) << "Free Image loading error while loading image file: " << TextureFileName << "for Bfont";
@@ -19,6 +20,7 @@ BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsiz
 	textureName = TextureFileName;
 
 	prog = shader;
+	b3d = blit3d;
 
 	//load the widths data file
 	std::ifstream data_file;
@@ -116,6 +118,9 @@ void BFont::BlitText(bool whichFont, float x, float y, std::string output)
 	dest_x = x;
 	dest_y = y;
 
+	//draw any batched sprites first, so the text ends up on top of them
+	b3d->Flush();
+
 	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
 
 	//bind our texture
@@ -172,7 +177,7 @@ float BFont::WidthText(bool whichFont, std::string output)
 BFont::~BFont(void)
 {
 	// free texture
-	texManager->FreeTexture(textureName);
+	texManager->FreeTexture(texHandle);
 
 	// delete VBO when object destroyed
 	glDeleteBuffers(1, &vboId);
@@ -16,6 +16,7 @@ class BFont
 	GLuint vaoId;	//ID of the VAO 		
 
 	GLuint texId; //ID of texture
+	TextureHandle texHandle; //our reference in the texture manager
 	std::string textureName; //filename of the texture
 	TextureManager *texManager; //pointer to the global texture manager
 	glm::mat4 modelMatrix; // Store the model matrix 
@@ -24,13 +25,14 @@ class BFont
 	float fontSize;
 	int widths[256];
 	GLSLProgram *prog; //our shader for 2d rendering
+	Blit3D *b3d;
 
 public:
 	GLfloat dest_x; //window coordinates of the center of the sprite, in pixels
 	GLfloat dest_y;
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha;//-Frderic Duguay
-	BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader);
+	BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d);
 
 	void BlitText(bool whichFont, float x, float y, std::string output); //draws the string
 	float WidthText(bool whichFont, std::string output);//returns the width of the text string, in pixels
@@ -142,7 +142,15 @@ void window_size_callback(GLFWwindow* window, int width, int height)
 Blit3D::Blit3D(Blit3DWindowModel windowMode, int width, int height)
 {
 	sManager = NULL;
-	tManager = NULL;	
+	tManager = NULL;
+	streamBuffer = NULL;
+	spriteBatch = NULL;
+	drawQueue = NULL;
+	spriteInstancer = NULL;
+	threadPool = NULL;
+	loaderPool = NULL;
+	camera2d = NULL;	
+	frameTime = 0.f;
 
 	Init = NULL;
 	Update = NULL;
@@ -170,13 +178,29 @@ Blit3D::Blit3D(Blit3DWindowModel windowMode, int width, int height)
 	farplane = 10000.f;
 
 	shader2d = NULL;
+	shader2dBatch = NULL;
+	shader2dInstanced = NULL;
 	window = NULL;
+
+	useSpriteBatching = false;
+	useDrawQueue = false;
+	useDepthSorting2D = false;
+	streamBytesPerFrame = 4 * 1024 * 1024;
+	streamFramesInFlight = 3;
 }
 
 Blit3D::Blit3D()
 {
 	sManager = NULL;
 	tManager = NULL;
+	streamBuffer = NULL;
+	spriteBatch = NULL;
+	drawQueue = NULL;
+	spriteInstancer = NULL;
+	threadPool = NULL;
+	loaderPool = NULL;
+	camera2d = NULL;
+	frameTime = 0.f;
 
 	Init = NULL;
 	Update = NULL;
@@ -203,25 +227,84 @@ Blit3D::Blit3D()
 	farplane = 10000.f;
 
 	shader2d = NULL;
+	shader2dBatch = NULL;
+	shader2dInstanced = NULL;
 	window = NULL;
+
+	useSpriteBatching = false;
+	useDrawQueue = false;
+	useDepthSorting2D = false;
+	streamBytesPerFrame = 4 * 1024 * 1024;
+	streamFramesInFlight = 3;
 }
 
 
 Blit3D::~Blit3D()
 {
 	//free all font memory first
-	for (std::unordered_set<AngelcodeFont *>::iterator itr = fontSet.begin(); itr != fontSet.end(); itr++)
+	fontPool.Clear();
+
+	//render buffers delete their own sprites
+	renderBufferPool.Clear();
+
+	//free the static layers before the sprites they point to
+	for (auto layer : layerSet)
 	{
-		delete *itr;
+		delete layer;
 	}
-	fontSet.clear(); // clear the elements 
+	layerSet.clear();
+
+	for (auto tileMap : tileMapSet)
+	{
+		delete tileMap;
+	}
+	tileMapSet.clear();
+
+	//only drops the atlases' references, sprites hold their own
+	for (auto atlas : atlasSet)
+	{
+		delete atlas;
+	}
+	atlasSet.clear();
+
+	for (auto emitter : emitterSet)
+	{
+		delete emitter;
+	}
+	emitterSet.clear();
+
+	//animated sprites own a sprite each, clips hold a sheet reference
+	animatedSpritePool.Clear();
+
+	for (auto clip : clipSet)
+	{
+		delete clip;
+	}
+	clipSet.clear();
 
 	//free all sprite memory
-	for(std::unordered_set<Sprite *>::iterator itr = spriteSet.begin(); itr != spriteSet.end(); itr++)
+	spritePool.Clear();
+
+	//free the shared sprite geometry, which also frees the textures
+	for (auto item : sheetMap)
 	{
-		delete *itr;
+		delete item.second;
 	}
-	spriteSet.clear(); // clear the elements 
+	sheetMap.clear();
+
+	for (auto seg : segmentSet)
+	{
+		delete seg;
+	}
+	segmentSet.clear();
+
+	if (camera2d) delete camera2d;
+	if (threadPool) delete threadPool;
+	if (loaderPool) delete loaderPool; //finishes any decodes still queued, before the TM goes
+	if (drawQueue) delete drawQueue;
+	if (spriteBatch) delete spriteBatch;
+	if (spriteInstancer) delete spriteInstancer;
+	if (streamBuffer) delete streamBuffer;
 
 	//free the managers and all of their associated memory
 	if (tManager) delete tManager;
@@ -451,6 +534,8 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 
 	projectionMatrix = glm::mat4(1.f);
 	viewMatrix = glm::mat4(1.f);
+	renderTargetSize = glm::vec2((float)screenWidth, (float)screenHeight);
+	frameTime = (float)glfwGetTime();
 
 	//glEnable(GL_CULL_FACE); // enables face culling    
 	glCullFace(GL_BACK); // tells OpenGL to cull back faces (the sane default setting)
@@ -466,30 +551,33 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 
 	//load default 2D shader
 	std::string vert2d = "#version 460 \n"
-		"uniform mat4 projectionMatrix; \n"
-		"uniform mat4 viewMatrix; \n"
+		FRAME_UNIFORMS_GLSL
 		"uniform mat4 modelMatrix; \n"
 		"layout(location = 0)in vec3 in_Position; \n"
 		"layout(location = 1)in vec2 in_Texcoord; \n"
+		"layout(location = 3)in vec4 in_Color; \n"
 		"uniform float in_Alpha = 1.0; \n"
 		"uniform float in_Scale_X = 1.0; \n"
 		"uniform float in_Scale_Y = 1.0; \n"
 		"out vec2 v_texcoord; \n"
+		"out vec4 v_color; \n"
 		"void main(void)\n"
 		"{\n"
 			"gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(in_Position.x * in_Scale_X, in_Position.y * in_Scale_Y, in_Position.z, 1.0); \n"
 			"v_texcoord = in_Texcoord; \n"
+			"v_color = in_Color; \n"
 		"}";
 
 	std::string frag2d = "#version 460 \n" 
 		"uniform sampler2D mytexture; \n" 
 		"in vec2 v_texcoord; \n" 
+		"in vec4 v_color; \n" 
 		"uniform float in_Alpha; \n" 
 		"out vec4 out_Color; \n" 
 		"void main(void)" 
 		"{ \n" 
 		"vec4 myTexel = texture2D(mytexture, v_texcoord); \n" 
-		"out_Color = myTexel * in_Alpha; \n" 
+		"out_Color = myTexel * v_color * in_Alpha; \n" 
 		"}";
 
 	shader2d = sManager->UseShader("shader2d_built_in.vert", "shader2d_built_in.frag", vert2d, frag2d); //load/compile/link
@@ -497,6 +585,81 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 	//shader2d->bindAttribLocation(0, "in_Position");
 	//shader2d->bindAttribLocation(1, "in_Texcoord");
 
+	//VAOs that leave the Color channel disabled get this value instead: untinted
+	glVertexAttrib4f(3, 1.f, 1.f, 1.f, 1.f);
+
+	//shader for batched sprites: the SpriteBatch has already applied the model transform,
+	//scaling, alpha and tint, so there are no per-sprite uniforms
+	std::string vert2dBatch = "#version 460 \n"
+		FRAME_UNIFORMS_GLSL
+		"layout(location = 0)in vec3 in_Position; \n"
+		"layout(location = 1)in vec2 in_Texcoord; \n"
+		"layout(location = 3)in vec4 in_Color; \n"
+		"out vec2 v_texcoord; \n"
+		"out vec4 v_color; \n"
+		"void main(void)\n"
+		"{\n"
+			"gl_Position = projectionMatrix * viewMatrix * vec4(in_Position, 1.0); \n"
+			"v_texcoord = in_Texcoord; \n"
+			"v_color = in_Color; \n"
+		"}";
+
+	std::string frag2dBatch = "#version 460 \n"
+		"uniform sampler2D mytexture; \n"
+		"in vec2 v_texcoord; \n"
+		"in vec4 v_color; \n"
+		"out vec4 out_Color; \n"
+		"void main(void)"
+		"{ \n"
+		"vec4 myTexel = texture2D(mytexture, v_texcoord); \n"
+		"out_Color = myTexel * v_color; \n"
+		"}";
+
+	shader2dBatch = sManager->GetShader("shader2dbatch_built_in.vert", "shader2dbatch_built_in.frag", vert2dBatch, frag2dBatch); //load/compile/link
+	//workers for CPU-side jobs, like building sprite batch segments
+	threadPool = new ThreadPool(0);
+	//LoadTextureAsync() decodes on its own workers: a burst of loads would otherwise sit in front of
+	//the frame's ParallelFor() chunks in the FIFO queue and stall the frame
+	int loaderThreads = (int)std::thread::hardware_concurrency() / 2;
+	loaderPool = new ThreadPool(loaderThreads < 1 ? 1 : loaderThreads);
+	tManager->SetThreadPool(loaderPool);
+
+	//dynamic geometry for the batch and the instancer is streamed through one mapped ring buffer
+	streamBuffer = new StreamBuffer(streamBytesPerFrame, streamFramesInFlight);
+	spriteBatch = new SpriteBatch(this, shader2dBatch, streamBuffer);
+	drawQueue = new DrawQueue(spriteBatch);
+	drawQueue->depthMode = useDepthSorting2D;
+
+	//shader for instanced sprites: one shared unit quad, everything else comes from the instance data.
+	//Location 3 is the Color channel, like the other built-in shaders
+	std::string vert2dInstanced = "#version 460 \n"
+		FRAME_UNIFORMS_GLSL
+		"layout(location = 0)in vec2 in_Corner; \n"
+		"layout(location = 1)in vec2 in_Texcoord; \n"
+		"layout(location = 2)in vec3 in_Instance; \n" //x, y, angle
+		"layout(location = 3)in vec4 in_Color; \n"
+		"layout(location = 4)in vec2 in_HalfSize; \n"
+		"layout(location = 5)in vec4 in_UVRect; \n"
+		"out vec2 v_texcoord; \n"
+		"out vec4 v_color; \n"
+		"void main(void)\n"
+		"{\n"
+			"vec2 corner = in_Corner * in_HalfSize; \n"
+			"float c = cos(in_Instance.z); \n"
+			"float s = sin(in_Instance.z); \n"
+			"vec2 position = vec2(corner.x * c - corner.y * s, corner.x * s + corner.y * c) + in_Instance.xy; \n"
+			"gl_Position = projectionMatrix * viewMatrix * vec4(position, 0.0, 1.0); \n"
+			"v_texcoord = mix(in_UVRect.xy, in_UVRect.zw, in_Texcoord); \n"
+			"v_color = in_Color; \n"
+		"}";
+
+	//the batch fragment shader does exactly what we need
+	shader2dInstanced = sManager->GetShader("shader2dinstanced_built_in.vert", "shader2dinstanced_built_in.frag", vert2dInstanced, frag2dBatch); //load/compile/link
+	spriteInstancer = new SpriteInstancer(this, shader2dInstanced, streamBuffer);
+	shader2d->use();
+
+	camera2d = new Camera2D(this);
+
 	//2d orthographic projection
 	SetMode(Blit3DRenderMode::BLIT2D);
 
@@ -539,10 +702,23 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 
 		while(!glfwWindowShouldClose(window))
 		{
+			frameTime = (float)glfwGetTime();
+			UpdateFrameUniforms();
+			//swap in async-loaded textures, a few milliseconds' worth per frame
+			tManager->ProcessUploads(tManager->uploadBudgetMs);
+			//worker threads building batch segments can only read the camera, so bring it up to date here
+			camera2d->Update();
 
 			Draw();
+			//draw any sprites still waiting in the batch
+			Flush();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
+			spriteBatch->EndFrame();
+			drawQueue->EndFrame();
+			camera2d->EndFrame();
+			spriteInstancer->EndFrame();
+			streamBuffer->EndFrame();
 
 			B3D::loopMutex.lock();
 			if(Sync != NULL) Sync();
@@ -564,10 +740,23 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 
 		while(!glfwWindowShouldClose(window))
 		{
+			frameTime = (float)glfwGetTime();
+			UpdateFrameUniforms();
+			//swap in async-loaded textures, a few milliseconds' worth per frame
+			tManager->ProcessUploads(tManager->uploadBudgetMs);
+			//worker threads building batch segments can only read the camera, so bring it up to date here
+			camera2d->Update();
 
 			Draw();
+			//draw any sprites still waiting in the batch
+			Flush();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
+			spriteBatch->EndFrame();
+			drawQueue->EndFrame();
+			camera2d->EndFrame();
+			spriteInstancer->EndFrame();
+			streamBuffer->EndFrame();
 
 			// update other events like input handling 
 			glfwPollEvents();
@@ -589,9 +778,23 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 						
 			Update(elapsedTime);
 
+			frameTime = (float)time;
+			UpdateFrameUniforms();
+			//swap in async-loaded textures, a few milliseconds' worth per frame
+			tManager->ProcessUploads(tManager->uploadBudgetMs);
+			//worker threads building batch segments can only read the camera, so bring it up to date here
+			camera2d->Update();
+
 			Draw();
+			//draw any sprites still waiting in the batch
+			Flush();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
+			spriteBatch->EndFrame();
+			drawQueue->EndFrame();
+			camera2d->EndFrame();
+			spriteInstancer->EndFrame();
+			streamBuffer->EndFrame();
 
 			// update other events like input handling 
 			glfwPollEvents();
@@ -610,29 +813,72 @@ error:
 	return 0;
 }
 
+SpriteSheet *Blit3D::FetchSpriteSheet(std::string TextureFileName)
+{
+	std::unordered_map<std::string, SpriteSheet *>::iterator itr = sheetMap.find(TextureFileName);
+	if(itr != sheetMap.end()) return itr->second;
+
+	//first sprite cut from this texture
+	SpriteSheet *sheet = new SpriteSheet(TextureFileName, tManager);
+	sheetMap[TextureFileName] = sheet;
+	return sheet;
+}
+
+void Blit3D::ReleaseSpriteSheet(SpriteSheet *sheet)
+{
+	sheet->refcount--;
+	if(sheet->refcount <= 0)
+	{
+		//last sprite using this sheet is gone, free the geometry and the texture
+		sheetMap.erase(sheet->textureName);
+		delete sheet;
+	}
+}
+
 Sprite *Blit3D::MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, std::string TextureFileName)
 {
 	//use a lock gaurd to lock until function returns
 	std::lock_guard<std::mutex> lock(spriteMutex);
 
-	//create a new sprite from a bitmap file
-	Sprite *sprite =  new Sprite(startX, startY, width, height, TextureFileName, tManager, shader2d);
+	//sprites cut from the same texture share one sheet
+	SpriteSheet *sheet = FetchSpriteSheet(TextureFileName);
+	int region = sheet->AddRegion(startX, startY, width, height);
+	sheet->refcount++;
 
-	//add sprite pointer to the set tracking all allocated sprites
-	spriteSet.insert(sprite);
+	//create a new sprite from a region of the sheet, in the pool tracking all allocated sprites
+	Sprite *sprite = spritePool.Create(sheet, region, tManager, shader2d, this);
 
 	return sprite;
 }
 
+Sprite *Blit3D::MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, TextureHandle texture)
+{
+	//sheets are shared by texture name, so go through it; the sheet takes its own reference
+	std::string name = tManager->NameOf(texture);
+	assert(!name.empty() && "MakeSprite() with a stale TextureHandle");
+	return MakeSprite(startX, startY, width, height, name);
+}
+
 Sprite*Blit3D::MakeSprite(RenderBuffer *rb)
 {
 	//use a lock gaurd to lock until function returns
 	std::lock_guard<std::mutex> lock(spriteMutex);
 
-	//create a new sprite from a renderbuffer
-	Sprite *sprite = new Sprite(rb, tManager, shader2d);
+	//create a new sheet for the renderbuffer's texture, if we don't have one yet
+	SpriteSheet *sheet = NULL;
+	std::unordered_map<std::string, SpriteSheet *>::iterator itr = sheetMap.find(rb->texname);
+	if(itr != sheetMap.end()) sheet = itr->second;
+	else
+	{
+		sheet = new SpriteSheet(rb, tManager);
+		sheetMap[rb->texname] = sheet;
+	}
 
-	spriteSet.insert(sprite);
+	int region = sheet->AddRegion(0.f, 0.f, (GLfloat)rb->texwidth, (GLfloat)rb->texheight);
+	sheet->refcount++;
+
+	//create a new sprite from a renderbuffer
+	Sprite *sprite = spritePool.Create(sheet, region, tManager, shader2d, this);
 
 	return sprite;
 }
@@ -642,12 +888,12 @@ void Blit3D::DeleteSprite(Sprite *sprite)
 	//use a lock gaurd to lock until function returns
 	std::lock_guard<std::mutex> lock(spriteMutex);
 
-	std::unordered_set<Sprite *>::iterator it = spriteSet.find(sprite);
-	if (it != spriteSet.end())
+	if (spritePool.Contains(sprite))
 	{
-		//delete the sprite and remove from set
-		delete *it;
-		spriteSet.erase(it);
+		//delete the sprite and give its slot back to the pool
+		SpriteSheet *sheet = sprite->GetSheet();
+		spritePool.Destroy(sprite);
+		ReleaseSpriteSheet(sheet);
 	}
 	else
 	{
@@ -655,22 +901,75 @@ void Blit3D::DeleteSprite(Sprite *sprite)
 	}
 }
 
+void Blit3D::DeleteSprite(B3D::Handle<Sprite> handle)
+{
+	Sprite *sprite = GetSprite(handle);
+	if(sprite == NULL)
+	{
+		oLog(Level::Warning) << "DeleteSprite() called with a stale handle, slot " << handle.index;
+		return;
+	}
+
+	DeleteSprite(sprite);
+}
+
+bool Blit3D::LoadSpriteAtlas(std::string atlasFile, std::unordered_map<std::string, Sprite *> &sprites)
+{
+	//parse everything before taking the lock
+	std::string imageFile;
+	std::vector<B3D::AtlasFrame> frames;
+	if(!B3D::ReadAtlasFile(atlasFile, imageFile, frames)) return false;
+	if(frames.empty())
+	{
+		oLog(Level::Warning) << "Atlas file " << atlasFile << " has no frames";
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(spriteMutex);
+
+	//one texture lookup and one sheet for the whole atlas
+	SpriteSheet *sheet = FetchSpriteSheet(imageFile);
+	sheet->regions.reserve(sheet->regions.size() + frames.size());
+	sprites.reserve(sprites.size() + frames.size());
+
+	int made = 0, rotatedFrames = 0, trimmedFrames = 0;
+	for(const B3D::AtlasFrame &frame : frames)
+	{
+		//keep the sprite already in the map, rather than leaving it allocated with nothing pointing at it
+		Sprite *&sprite = sprites[frame.name];
+		if(sprite != NULL)
+		{
+			oLog(Level::Warning) << "Atlas file " << atlasFile << ": skipping frame " << frame.name << ", there is already a sprite with that name";
+			continue;
+		}
+
+		//rotated frames are turned back when drawn, trimmed ones are drawn offset so they keep the original image's center
+		if(frame.rotated) rotatedFrames++;
+		if(frame.trimmed) trimmedFrames++;
+		int region = sheet->AddRegion(frame.x, frame.y, frame.width, frame.height, frame.rotated, frame.offsetX, frame.offsetY);
+
+		sprite = spritePool.Create(sheet, region, tManager, shader2d, this);
+		made++;
+	}
+	sheet->refcount += made;
+
+	oLog(Level::Info) << "Loaded " << made << " sprites from atlas " << atlasFile << " (" << rotatedFrames << " rotated, " << trimmedFrames << " trimmed)";
+
+	return true;
+}
+
 BFont *Blit3D::MakeBFont(std::string TextureFileName, std::string widths_file, float fontsize)
 {
-	return new BFont(TextureFileName, widths_file, fontsize, tManager, shader2d);
+	return new BFont(TextureFileName, widths_file, fontsize, tManager, shader2d, this);
 }
 
 AngelcodeFont *Blit3D::MakeAngelcodeFontFromBinary32(std::string filename)
 {
 	//use a lock gaurd to lock until function returns
-	std::lock_guard<std::mutex> lock(spriteMutex);
+	std::lock_guard<std::mutex> lock(fontMutex);
 
 	//create new font
-	AngelcodeFont *afont = new AngelcodeFont(filename, tManager, shader2d);
-	
-	fontSet.insert(afont);
-	
-	return afont;
+	return fontPool.Create(filename, tManager, shader2d, this);
 }
 
 void Blit3D::DeleteFont(AngelcodeFont *font)
@@ -678,29 +977,388 @@ void Blit3D::DeleteFont(AngelcodeFont *font)
 	//use a lock gaurd to lock until function returns
 	std::lock_guard<std::mutex> lock(fontMutex);
 
-	std::unordered_set<AngelcodeFont *>::iterator it = fontSet.find(font);
-	if (it != fontSet.end())
+	if (!fontPool.Destroy(font))
 	{
-		//delete the sprite and remove from set
-		delete *it;
-		fontSet.erase(it);
+		oLog(Level::Warning) << "DeleteFont() called on non-existant font * " << font;
 	}
-	else
+}
+
+void Blit3D::DeleteFont(B3D::Handle<AngelcodeFont> handle)
+{
+	std::lock_guard<std::mutex> lock(fontMutex);
+
+	if (!fontPool.Destroy(handle))
 	{
-		oLog(Level::Warning) << "DeleteFont() called on non-existant font * " << font;
+		oLog(Level::Warning) << "DeleteFont() called with a stale handle, slot " << handle.index;
 	}
 }
 
 RenderBuffer *Blit3D::MakeRenderBuffer(int width, int height, std::string name)
 {
-	return new RenderBuffer(width, height, tManager, name, this);
+	std::lock_guard<std::mutex> lock(renderBufferMutex);
+	return renderBufferPool.Create(width, height, tManager, name, this);
+}
+
+void Blit3D::DeleteRenderBuffer(RenderBuffer *renderBuffer)
+{
+	std::lock_guard<std::mutex> lock(renderBufferMutex);
+
+	if (!renderBufferPool.Destroy(renderBuffer))
+	{
+		oLog(Level::Warning) << "DeleteRenderBuffer() called on non-existant RenderBuffer * " << renderBuffer;
+	}
+}
+
+void Blit3D::DeleteRenderBuffer(B3D::Handle<RenderBuffer> handle)
+{
+	std::lock_guard<std::mutex> lock(renderBufferMutex);
+
+	if (!renderBufferPool.Destroy(handle))
+	{
+		oLog(Level::Warning) << "DeleteRenderBuffer() called with a stale handle, slot " << handle.index;
+	}
+}
+
+B3D::Handle<Sprite> Blit3D::GetHandle(Sprite *sprite)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+	return spritePool.HandleOf(sprite);
+}
+
+B3D::Handle<AngelcodeFont> Blit3D::GetHandle(AngelcodeFont *font)
+{
+	std::lock_guard<std::mutex> lock(fontMutex);
+	return fontPool.HandleOf(font);
+}
+
+B3D::Handle<RenderBuffer> Blit3D::GetHandle(RenderBuffer *renderBuffer)
+{
+	std::lock_guard<std::mutex> lock(renderBufferMutex);
+	return renderBufferPool.HandleOf(renderBuffer);
+}
+
+Sprite *Blit3D::GetSprite(B3D::Handle<Sprite> handle)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+	return spritePool.Get(handle);
+}
+
+AngelcodeFont *Blit3D::GetFont(B3D::Handle<AngelcodeFont> handle)
+{
+	std::lock_guard<std::mutex> lock(fontMutex);
+	return fontPool.Get(handle);
+}
+
+RenderBuffer *Blit3D::GetRenderBuffer(B3D::Handle<RenderBuffer> handle)
+{
+	std::lock_guard<std::mutex> lock(renderBufferMutex);
+	return renderBufferPool.Get(handle);
+}
+
+void Blit3D::SetSpriteBatching(bool useBatching)
+{
+	useSpriteBatching = useBatching;
+
+	if(spriteBatch == NULL) return; //Run() hasn't created the batch yet
+
+	//anything already batched gets drawn before we switch
+	spriteBatch->Flush();
+	spriteBatch->active = useSpriteBatching && mode == Blit3DRenderMode::BLIT2D;
+}
+
+void Blit3D::SetDrawQueue(bool useQueue)
+{
+	useDrawQueue = useQueue;
+
+	if(drawQueue == NULL) return; //Run() hasn't created the queue yet
+
+	//anything already queued gets drawn before we switch
+	Flush();
+	drawQueue->active = useDrawQueue && mode == Blit3DRenderMode::BLIT2D;
+}
+
+void Blit3D::SetDepthSorting2D(bool useDepth)
+{
+	useDepthSorting2D = useDepth;
+
+	if(drawQueue == NULL) return; //Run() hasn't created the queue yet
+
+	//anything already queued was keyed for the old mode
+	Flush();
+	drawQueue->depthMode = useDepthSorting2D;
+}
+
+void Blit3D::Flush(void)
+{
+	//the batched paths read the matrices from the frame block, so pick up any direct changes to them
+	if(sManager) UpdateFrameUniforms();
+
+	//the queue executes into the batch, so it goes first
+	if(drawQueue) drawQueue->Flush();
+	if(spriteBatch) spriteBatch->Flush();
+	if(spriteInstancer) spriteInstancer->Flush();
+}
+
+void Blit3D::UpdateFrameUniforms(void)
+{
+	sManager->SetFrameUniforms(projectionMatrix, viewMatrix, renderTargetSize, frameTime);
+}
+
+AnimationClip *Blit3D::MakeAnimationClip(std::string TextureFileName, const std::vector<B3D::FrameRect> &frames,
+	float framesPerSecond, B3D::AnimationLoop loop)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+
+	//every frame becomes a region of the shared sheet, the clip keeps the sheet alive
+	SpriteSheet *sheet = FetchSpriteSheet(TextureFileName);
+	sheet->refcount++;
+
+	AnimationClip *clip = new AnimationClip(sheet, frames, framesPerSecond, loop);
+	clipSet.insert(clip);
+
+	return clip;
+}
+
+AnimationClip *Blit3D::MakeAnimationClip(std::string TextureFileName, GLfloat startX, GLfloat startY, GLfloat frameWidth, GLfloat frameHeight,
+	int columns, int frameCount, float framesPerSecond, B3D::AnimationLoop loop)
+{
+	assert(columns > 0 && frameCount > 0);
+
+	std::vector<B3D::FrameRect> frames(frameCount);
+	for(int i = 0; i < frameCount; ++i)
+	{
+		frames[i].x = startX + (i % columns) * frameWidth;
+		frames[i].y = startY + (i / columns) * frameHeight;
+		frames[i].width = frameWidth;
+		frames[i].height = frameHeight;
+	}
+
+	return MakeAnimationClip(TextureFileName, frames, framesPerSecond, loop);
+}
+
+AnimationClip *Blit3D::MakeAnimationClip(TextureHandle texture, const std::vector<B3D::FrameRect> &frames,
+	float framesPerSecond, B3D::AnimationLoop loop)
+{
+	std::string name = tManager->NameOf(texture);
+	assert(!name.empty() && "MakeAnimationClip() with a stale TextureHandle");
+	return MakeAnimationClip(name, frames, framesPerSecond, loop);
+}
+
+AnimationClip *Blit3D::MakeAnimationClip(TextureHandle texture, GLfloat startX, GLfloat startY, GLfloat frameWidth, GLfloat frameHeight,
+	int columns, int frameCount, float framesPerSecond, B3D::AnimationLoop loop)
+{
+	std::string name = tManager->NameOf(texture);
+	assert(!name.empty() && "MakeAnimationClip() with a stale TextureHandle");
+	return MakeAnimationClip(name, startX, startY, frameWidth, frameHeight, columns, frameCount, framesPerSecond, loop);
+}
+
+void Blit3D::DeleteAnimationClip(AnimationClip *clip)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+
+	if(clipSet.erase(clip))
+	{
+		SpriteSheet *sheet = clip->sheet;
+		delete clip;
+		ReleaseSpriteSheet(sheet);
+	}
+	else
+	{
+		oLog(Level::Warning) << "DeleteAnimationClip() called on non-existant AnimationClip * " << clip;
+	}
+}
+
+AnimatedSprite *Blit3D::MakeAnimatedSprite(AnimationClip *clip)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+
+	//one sprite on the clip's sheet, its region gets swapped as the frames change
+	clip->sheet->refcount++;
+	Sprite *sprite = spritePool.Create(clip->sheet, clip->frames[0], tManager, shader2d, this);
+
+	return animatedSpritePool.Create(clip, sprite);
+}
+
+void Blit3D::DeleteAnimatedSprite(AnimatedSprite *animatedSprite)
+{
+	Sprite *sprite = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(spriteMutex);
+
+		if(!animatedSpritePool.Contains(animatedSprite))
+		{
+			oLog(Level::Warning) << "DeleteAnimatedSprite() called on non-existant AnimatedSprite * " << animatedSprite;
+			return;
+		}
+
+		sprite = animatedSprite->sprite;
+		animatedSpritePool.Destroy(animatedSprite);
+	}
+
+	DeleteSprite(sprite);
+}
+
+void Blit3D::UpdateAnimations(double seconds)
+{
+	std::lock_guard<std::mutex> lock(spriteMutex);
+
+	animatedSpritePool.ForEach([seconds](AnimatedSprite *animated) { animated->Update(seconds); });
+}
+
+StaticLayer *Blit3D::MakeStaticLayer(void)
+{
+	StaticLayer *layer = new StaticLayer(this);
+
+	std::lock_guard<std::mutex> lock(layerMutex);
+	layerSet.insert(layer);
+
+	return layer;
+}
+
+void Blit3D::DeleteStaticLayer(StaticLayer *layer)
+{
+	std::lock_guard<std::mutex> lock(layerMutex);
+	if(layerSet.erase(layer)) delete layer;
+}
+
+Sprite *Blit3D::MakeSprite(const B3D::AtlasRegion &region)
+{
+	assert(region.page >= 0 && "MakeSprite() from an atlas region that wasn't packed");
+	return MakeSprite(region.x, region.y, region.width, region.height, region.textureHandle);
+}
+
+TextureAtlas *Blit3D::MakeTextureAtlas(std::string name, int pageWidth, int pageHeight, int padding, int extrude)
+{
+	TextureAtlas *atlas = new TextureAtlas(this, name, pageWidth, pageHeight, padding, extrude);
+
+	std::lock_guard<std::mutex> lock(atlasMutex);
+	atlasSet.insert(atlas);
+
+	return atlas;
+}
+
+void Blit3D::DeleteTextureAtlas(TextureAtlas *atlas)
+{
+	std::lock_guard<std::mutex> lock(atlasMutex);
+	if(atlasSet.erase(atlas)) delete atlas;
+}
+
+TileMap *Blit3D::MakeTileMap(std::string tilesetFile, int tileWidth, int tileHeight, int widthInTiles, int heightInTiles, int chunkTiles)
+{
+	TileMap *tileMap = new TileMap(this, tilesetFile, tileWidth, tileHeight, widthInTiles, heightInTiles, chunkTiles);
+
+	std::lock_guard<std::mutex> lock(tileMapMutex);
+	tileMapSet.insert(tileMap);
+
+	return tileMap;
+}
+
+TileMap *Blit3D::MakeTileMap(TextureHandle tileset, int tileWidth, int tileHeight, int widthInTiles, int heightInTiles, int chunkTiles)
+{
+	std::string name = tManager->NameOf(tileset);
+	assert(!name.empty() && "MakeTileMap() with a stale TextureHandle");
+	return MakeTileMap(name, tileWidth, tileHeight, widthInTiles, heightInTiles, chunkTiles);
+}
+
+void Blit3D::DeleteTileMap(TileMap *tileMap)
+{
+	std::lock_guard<std::mutex> lock(tileMapMutex);
+	if(tileMapSet.erase(tileMap)) delete tileMap;
+}
+
+ParticleEmitter *Blit3D::MakeParticleEmitter(std::string TextureFileName, int maxParticles)
+{
+	ParticleEmitter *emitter = new ParticleEmitter(this, TextureFileName, maxParticles);
+
+	std::lock_guard<std::mutex> lock(emitterMutex);
+	emitterSet.insert(emitter);
+
+	return emitter;
+}
+
+ParticleEmitter *Blit3D::MakeParticleEmitter(std::string TextureFileName, GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, int maxParticles)
+{
+	ParticleEmitter *emitter = new ParticleEmitter(this, TextureFileName, startX, startY, width, height, maxParticles);
+
+	std::lock_guard<std::mutex> lock(emitterMutex);
+	emitterSet.insert(emitter);
+
+	return emitter;
+}
+
+ParticleEmitter *Blit3D::MakeParticleEmitter(TextureHandle texture, int maxParticles)
+{
+	std::string name = tManager->NameOf(texture);
+	assert(!name.empty() && "MakeParticleEmitter() with a stale TextureHandle");
+	return MakeParticleEmitter(name, maxParticles);
+}
+
+ParticleEmitter *Blit3D::MakeParticleEmitter(TextureHandle texture, GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, int maxParticles)
+{
+	std::string name = tManager->NameOf(texture);
+	assert(!name.empty() && "MakeParticleEmitter() with a stale TextureHandle");
+	return MakeParticleEmitter(name, startX, startY, width, height, maxParticles);
+}
+
+void Blit3D::DeleteParticleEmitter(ParticleEmitter *emitter)
+{
+	std::lock_guard<std::mutex> lock(emitterMutex);
+	if(emitterSet.erase(emitter)) delete emitter;
+}
+
+void Blit3D::UpdateParticles(double seconds)
+{
+	std::lock_guard<std::mutex> lock(emitterMutex);
+
+	for(ParticleEmitter *emitter : emitterSet) emitter->Update(seconds);
+}
+
+SpriteBatchSegment *Blit3D::MakeBatchSegment(void)
+{
+	SpriteBatchSegment *segment = new SpriteBatchSegment();
+
+	std::lock_guard<std::mutex> lock(segmentMutex);
+	segmentSet.insert(segment);
+
+	return segment;
+}
+
+void Blit3D::DeleteBatchSegment(SpriteBatchSegment *segment)
+{
+	std::lock_guard<std::mutex> lock(segmentMutex);
+	if(segmentSet.erase(segment)) delete segment;
+}
+
+void Blit3D::SubmitBatchSegment(SpriteBatchSegment *segment)
+{
+	//anything queued before the segment is drawn before it
+	if(drawQueue) drawQueue->Flush();
+
+	spriteBatch->AddSegment(*segment);
+	camera2d->AddCounts(segment->visibleCount, segment->culledCount);
+	segment->Clear();
+}
+
+void Blit3D::SetStreamBufferSize(GLsizeiptr bytesPerFrame, int framesInFlight)
+{
+	assert(streamBuffer == NULL && "SetStreamBufferSize() must be called before Run()");
+	assert(bytesPerFrame > 0 && framesInFlight > 0);
+
+	streamBytesPerFrame = bytesPerFrame;
+	streamFramesInFlight = framesInFlight;
 }
 
 void Blit3D::SetMode(Blit3DRenderMode newMode)
 {
 	//if(mode == newMode) return;
 
+	//sprites batched so far belong to the old mode and shader
+	Flush();
+
 	mode = newMode;
+	if(spriteBatch) spriteBatch->active = useSpriteBatching && mode == Blit3DRenderMode::BLIT2D;
+	if(drawQueue) drawQueue->active = useDrawQueue && mode == Blit3DRenderMode::BLIT2D;
 
 	if(mode == Blit3DRenderMode::BLIT3D)
 	{
@@ -709,11 +1367,10 @@ void Blit3D::SetMode(Blit3DRenderMode newMode)
 		//3D perspective projection
 		projectionMatrix = glm::mat4(1.f) * glm::perspective(glm::radians(45.0f), (GLfloat)(screenWidth) / (GLfloat)(screenHeight), nearplane, farplane);
 	
+		//send matrices to the frame block
+		UpdateFrameUniforms();
+
 		shader2d->use();
-		//send matrices to the shader
-		shader2d->setUniform("projectionMatrix", projectionMatrix);
-		//TODO: make a backup of view matrix and projection matrix.
-		shader2d->setUniform("viewMatrix", viewMatrix);
 
 		//send alpha to the shader
 		shader2d->setUniform("in_Alpha", 1.f);
@@ -727,11 +1384,17 @@ void Blit3D::SetMode(Blit3DRenderMode newMode)
 		//2d orthographic projection
 		projectionMatrix = glm::mat4(1.f) * glm::ortho(0.f, (float)screenWidth, 0.f, (float)screenHeight, 0.f, 1.f);
 
+		//the camera owns the view in 2D
+		if(camera2d)
+		{
+			camera2d->MarkDirty();
+			camera2d->Update();
+		}
+
+		//send matrices to the frame block
+		UpdateFrameUniforms();
+
 		shader2d->use();
-		//send matrices to the shader
-		shader2d->setUniform("projectionMatrix", projectionMatrix);
-//TODO: make a backup of view matrix and projection matrix.
-		shader2d->setUniform("viewMatrix", viewMatrix);
 
 		//send alpha to the shader
 		shader2d->setUniform("in_Alpha", 1.f);	
@@ -745,7 +1408,12 @@ void Blit3D::SetMode(Blit3DRenderMode newMode, GLSLProgram *shader)
 {
 	//if(mode == newMode) return;
 
+	//sprites batched so far belong to the old mode and shader
+	Flush();
+
 	mode = newMode;
+	if(spriteBatch) spriteBatch->active = useSpriteBatching && mode == Blit3DRenderMode::BLIT2D;
+	if(drawQueue) drawQueue->active = useDrawQueue && mode == Blit3DRenderMode::BLIT2D;
 
 	if(mode == Blit3DRenderMode::BLIT3D)
 	{
@@ -756,10 +1424,10 @@ void Blit3D::SetMode(Blit3DRenderMode newMode, GLSLProgram *shader)
 		
 		shader->use();
 
-		//send matrices to the shader
-		shader->setUniform("projectionMatrix", projectionMatrix);
-		//TODO: make a backup of view matrix and projection matrix.
-		shader->setUniform("viewMatrix", viewMatrix);
+		//send matrices to the frame block, and to shaders that still have their own copies
+		UpdateFrameUniforms();
+		if(shader->hasUniform("projectionMatrix")) shader->setUniform("projectionMatrix", projectionMatrix);
+		if(shader->hasUniform("viewMatrix")) shader->setUniform("viewMatrix", viewMatrix);
 
 	}
 	else
@@ -769,12 +1437,19 @@ void Blit3D::SetMode(Blit3DRenderMode newMode, GLSLProgram *shader)
 		//2d orthographic projection
 		projectionMatrix = glm::mat4(1.f) * glm::ortho(0.f, (float)screenWidth, 0.f, (float)screenHeight, 0.f, 1.f);
 
+		//the camera owns the view in 2D
+		if(camera2d)
+		{
+			camera2d->MarkDirty();
+			camera2d->Update();
+		}
+
 		shader->use();
 
-		//send matrices to the shader
-		shader->setUniform("projectionMatrix", projectionMatrix);
-		//TODO: make a backup of view matrix and projection matrix.
-		shader->setUniform("viewMatrix", viewMatrix);
+		//send matrices to the frame block, and to shaders that still have their own copies
+		UpdateFrameUniforms();
+		if(shader->hasUniform("projectionMatrix")) shader->setUniform("projectionMatrix", projectionMatrix);
+		if(shader->hasUniform("viewMatrix")) shader->setUniform("viewMatrix", viewMatrix);
 
 		//send alpha to the shader
 		shader->setUniform("in_Alpha", 1.f);
@@ -791,6 +1466,9 @@ Blit3DRenderMode Blit3D::GetMode(void)
 
 void Blit3D::Reshape(GLSLProgram *shader)
 {
+	Flush(); //batched sprites were meant for the old viewport
+	if(camera2d) camera2d->MarkDirty(); //the camera centers on the screen, so its view depends on the size
+
 	glViewport(0, 0, (GLsizei)(screenWidth), (GLsizei)(screenHeight));						// Reset The Current Viewport
 
 	projectionMatrix = glm::mat4(1.0); //glLoadIdentity
@@ -808,13 +1486,18 @@ void Blit3D::Reshape(GLSLProgram *shader)
 		projectionMatrix *= glm::ortho(0.f, (GLfloat)(screenWidth), 0.f, (GLfloat)(screenHeight), 0.f, 1.f); // identical to glOrtho();
 	}
 
-	//the projection matrix must be reset in the active shader!
-	shader->setUniform("projectionMatrix", projectionMatrix);
+	renderTargetSize = glm::vec2((float)screenWidth, (float)screenHeight);
+
+	//the projection matrix must be reset in the frame block, and in shaders that still have their own copy
+	UpdateFrameUniforms();
+	if(shader->hasUniform("projectionMatrix")) shader->setUniform("projectionMatrix", projectionMatrix);
 	
 }
 
 void Blit3D::ReshapFBO(int FBOwidth, int FBOheight, GLSLProgram *shader)
 {
+	Flush(); //batched sprites were meant for the old viewport
+
 	glViewport(0, 0, (GLsizei)(FBOwidth), (GLsizei)(FBOheight));						// Reset The Current Viewport
 
 	projectionMatrix = glm::mat4(1.0); //glLoadIdentity
@@ -831,8 +1514,10 @@ void Blit3D::ReshapFBO(int FBOwidth, int FBOheight, GLSLProgram *shader)
 
 		projectionMatrix *= glm::ortho(0.f, (float)FBOwidth, 0.f, (float)FBOheight, 0.f, 1.f); // identical to glOrtho();
 	}
+	renderTargetSize = glm::vec2((float)FBOwidth, (float)FBOheight);
+
 	//send projection matrix
-	if(shader == NULL) shader = shader2d;
-	shader->setUniform("projectionMatrix", projectionMatrix);
+	UpdateFrameUniforms();
+	if(shader != NULL && shader->hasUniform("projectionMatrix")) shader->setUniform("projectionMatrix", projectionMatrix);
 }
 
@@ -77,10 +77,25 @@ version 0.11
 #include <atomic>
 #include <mutex>
 
+#include "HandlePool.h"
 #include "TextureManager.h"
 #include "ShaderManager.h"
 #include "RenderBuffer.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+#include "SpriteBatch.h"
+#include "SpriteTransform.h"
+#include "DrawQueue.h"
+#include "SpriteInstancer.h"
+#include "SpriteSheet.h"
+#include "AtlasLoader.h"
+#include "TextureAtlas.h"
+#include "Camera2D.h"
 #include "Sprite.h"
+#include "StaticLayer.h"
+#include "TileMap.h"
+#include "ParticleSystem.h"
+#include "Animation.h"
 #include "BFont.h"
 #include "AngelcodeFont.h"
 
@@ -89,6 +104,9 @@ version 0.11
 //to help calculate bytes accurately.
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
+//tiles along each side of a TileMap chunk, unless MakeTileMap() is told otherwise
+#define TILEMAP_CHUNK_SIZE 32
+
 
 namespace B3D
 {
@@ -108,6 +126,16 @@ namespace B3D
 		int buttonCount; //how many buttons there are for this joystick
 		const unsigned char *buttonStates; //array of buttonCount unsigned chars, will either be GLFW_PRESS or GLFW_RELEASE in value
 	};	
+
+	//how an AnimationClip plays past its last frame
+	enum class AnimationLoop { LOOP = 0, ONCE, PINGPONG };
+
+	//position and size of one animation frame on the spritesheet, in pixels
+	class FrameRect
+	{
+	public:
+		GLfloat x, y, width, height;
+	};
 }
 
 enum class Blit3DThreadModel { SINGLETHREADED = 1, SIMPLEMULTITHREADED, MULTITHREADED };
@@ -123,17 +151,42 @@ class Sprite;
 class BFont;
 class RenderBuffer;
 class AngelcodeFont;
+class StreamBuffer;
+class SpriteBatch;
+class SpriteBatchSegment;
+class DrawQueue;
+class SpriteInstancer;
+class SpriteSheet;
+class Camera2D;
+class StaticLayer;
+class TileMap;
+class TextureAtlas;
+class ParticleEmitter;
+class AnimationClip;
+class AnimatedSprite;
 
 class Blit3D
 {
 public:
 	ShaderManager *sManager;
 	TextureManager *tManager;
+	StreamBuffer *streamBuffer; //per-frame vertex memory for the batch and the instancer
+	SpriteBatch *spriteBatch;
+	DrawQueue *drawQueue;
+	SpriteInstancer *spriteInstancer;
+	ThreadPool *threadPool; //worker threads for CPU-side work, never for GL calls
+	ThreadPool *loaderPool; //decodes LoadTextureAsync() images, separate so per-frame ParallelFor() jobs never queue behind them
+	Camera2D *camera2d; //off by default, see Camera2D.h
 
 	GLFWwindow* window;
 
+	//built-in shaders read these from the frame uniform block (see ShaderManager.h), which is refreshed
+	//when they change through Blit3D and at every Flush(), so after changing them yourself call Flush()
+	//or UpdateFrameUniforms() before drawing with your own shaders
 	glm::mat4 projectionMatrix;
 	glm::mat4 viewMatrix;
+	glm::vec2 renderTargetSize; //size of the screen or FBO we are drawing to, in pixels
+	float frameTime; //seconds since Blit3D started, taken once at the start of each frame
 
 	Blit3DRenderMode mode;
 
@@ -142,6 +195,8 @@ public:
 
 	float nearplane, farplane;
 	GLSLProgram *shader2d;
+	GLSLProgram *shader2dBatch; //used by the SpriteBatch, vertices are pre-transformed
+	GLSLProgram *shader2dInstanced; //used by the SpriteInstancer
 
 	//function pointers
 private:
@@ -159,10 +214,42 @@ private:
 	void(*DoResize)(int, int) = NULL;
 
 	std::mutex spriteMutex;
-	std::unordered_set<Sprite *> spriteSet;
+	B3D::HandlePool<Sprite> spritePool;
+	std::unordered_map<std::string, SpriteSheet *> sheetMap; //shared geometry, one per texture, also guarded by spriteMutex
+
+	std::mutex segmentMutex;
+	std::unordered_set<SpriteBatchSegment *> segmentSet;
+
+	std::unordered_set<AnimationClip *> clipSet; //guarded by spriteMutex, clips hold a sheet reference
+	B3D::HandlePool<AnimatedSprite> animatedSpritePool; //slots are contiguous, so UpdateAnimations() is one tight loop; also guarded by spriteMutex
+
+	std::mutex layerMutex;
+	std::unordered_set<StaticLayer *> layerSet;
+
+	std::mutex tileMapMutex;
+	std::unordered_set<TileMap *> tileMapSet;
+
+	std::mutex atlasMutex;
+	std::unordered_set<TextureAtlas *> atlasSet;
+
+	std::mutex emitterMutex;
+	std::unordered_set<ParticleEmitter *> emitterSet;
 
 	std::mutex fontMutex;
-	std::unordered_set<AngelcodeFont *> fontSet;
+	B3D::HandlePool<AngelcodeFont> fontPool;
+
+	std::mutex renderBufferMutex;
+	B3D::HandlePool<RenderBuffer> renderBufferPool;
+
+	bool useSpriteBatching;
+	bool useDrawQueue;
+	bool useDepthSorting2D;
+	GLsizeiptr streamBytesPerFrame;
+	int streamFramesInFlight;
+
+	//sheet bookkeeping, call with spriteMutex held
+	SpriteSheet *FetchSpriteSheet(std::string TextureFileName);
+	void ReleaseSpriteSheet(SpriteSheet *sheet);
 	
 public:	
 
@@ -177,14 +264,74 @@ public:
 	void Quit(void);
 
 	Sprite *MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, std::string TextureFileName);
+	//every factory that takes a texture name also takes a TextureHandle from the TextureManager; the handle must be live
+	Sprite *MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, TextureHandle texture);
 	Sprite *MakeSprite(RenderBuffer *rb);
+	Sprite *MakeSprite(const B3D::AtlasRegion &region); //an image packed into a TextureAtlas
 	void DeleteSprite(Sprite *sprite);
+	void DeleteSprite(B3D::Handle<Sprite> handle);
+	//makes a sprite for every frame in a TexturePacker JSON (hash or array) or XML SubTexture atlas file,
+	//all on one shared sheet, and adds them to sprites by frame name. Rotated and trimmed frames draw upright and
+	//centered like the original images; a name already in sprites keeps its sprite. Returns false if the file can't be read
+	bool LoadSpriteAtlas(std::string atlasFile, std::unordered_map<std::string, Sprite *> &sprites);
+
+	//animation clips: frame rects on one spritesheet, see Animation.h
+	AnimationClip *MakeAnimationClip(std::string TextureFileName, const std::vector<B3D::FrameRect> &frames,
+		float framesPerSecond, B3D::AnimationLoop loop);
+	//same, with frameCount frames laid out left to right, top to bottom, in a grid starting at startX,startY
+	AnimationClip *MakeAnimationClip(std::string TextureFileName, GLfloat startX, GLfloat startY, GLfloat frameWidth, GLfloat frameHeight,
+		int columns, int frameCount, float framesPerSecond, B3D::AnimationLoop loop);
+	AnimationClip *MakeAnimationClip(TextureHandle texture, const std::vector<B3D::FrameRect> &frames,
+		float framesPerSecond, B3D::AnimationLoop loop);
+	AnimationClip *MakeAnimationClip(TextureHandle texture, GLfloat startX, GLfloat startY, GLfloat frameWidth, GLfloat frameHeight,
+		int columns, int frameCount, float framesPerSecond, B3D::AnimationLoop loop);
+	void DeleteAnimationClip(AnimationClip *clip);
+	AnimatedSprite *MakeAnimatedSprite(AnimationClip *clip);
+	void DeleteAnimatedSprite(AnimatedSprite *animatedSprite);
+	void UpdateAnimations(double seconds); //advances every AnimatedSprite, call from Update()
+
+	//retained layers of sprites that don't move, see StaticLayer.h
+	StaticLayer *MakeStaticLayer(void);
+	void DeleteStaticLayer(StaticLayer *layer);
+
+	//atlases packed at runtime from loose images, see TextureAtlas.h
+	TextureAtlas *MakeTextureAtlas(std::string name, int pageWidth = 2048, int pageHeight = 2048, int padding = 2, int extrude = 1);
+	void DeleteTextureAtlas(TextureAtlas *atlas);
+
+	//chunked tilemaps, see TileMap.h
+	TileMap *MakeTileMap(std::string tilesetFile, int tileWidth, int tileHeight, int widthInTiles, int heightInTiles,
+		int chunkTiles = TILEMAP_CHUNK_SIZE);
+	TileMap *MakeTileMap(TextureHandle tileset, int tileWidth, int tileHeight, int widthInTiles, int heightInTiles,
+		int chunkTiles = TILEMAP_CHUNK_SIZE);
+	void DeleteTileMap(TileMap *tileMap);
+
+	//particle emitters, see ParticleSystem.h
+	ParticleEmitter *MakeParticleEmitter(std::string TextureFileName, int maxParticles);
+	ParticleEmitter *MakeParticleEmitter(std::string TextureFileName, GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, int maxParticles);
+	ParticleEmitter *MakeParticleEmitter(TextureHandle texture, int maxParticles);
+	ParticleEmitter *MakeParticleEmitter(TextureHandle texture, GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, int maxParticles);
+	void DeleteParticleEmitter(ParticleEmitter *emitter);
+	void UpdateParticles(double seconds); //advances every ParticleEmitter, call from Update()
 	
+	//RenderBuffers live in a pool, so they can't be deleted: use DeleteRenderBuffer(), or let Blit3D free them when it is destroyed.
+	//Older code that did "delete rb;" no longer compiles; replace it with blit3D->DeleteRenderBuffer(rb)
 	RenderBuffer *MakeRenderBuffer(int width, int height, std::string name);
+	void DeleteRenderBuffer(RenderBuffer *renderBuffer);
+	void DeleteRenderBuffer(B3D::Handle<RenderBuffer> handle);
 	
 	BFont *MakeBFont(std::string TextureFileName, std::string widths_file, float fontsize);
 	AngelcodeFont *MakeAngelcodeFontFromBinary32(std::string filename);
 	void DeleteFont(AngelcodeFont *font);
+	void DeleteFont(B3D::Handle<AngelcodeFont> handle);
+
+	//generational handles for sprites, fonts and render buffers: safe to keep around after the object is deleted,
+	//the Get*() calls return NULL for a stale handle instead of a dangling pointer. See HandlePool.h
+	B3D::Handle<Sprite> GetHandle(Sprite *sprite);
+	B3D::Handle<AngelcodeFont> GetHandle(AngelcodeFont *font);
+	B3D::Handle<RenderBuffer> GetHandle(RenderBuffer *renderBuffer);
+	Sprite *GetSprite(B3D::Handle<Sprite> handle);
+	AngelcodeFont *GetFont(B3D::Handle<AngelcodeFont> handle);
+	RenderBuffer *GetRenderBuffer(B3D::Handle<RenderBuffer> handle);
 	
 	void Reshape(GLSLProgram *shader);
 	void ReshapFBO(int FBOwidth, int FBOheight, GLSLProgram *shader);
@@ -192,6 +339,25 @@ public:
 	void SetMode(Blit3DRenderMode newMode, GLSLProgram *shader);
 	Blit3DRenderMode GetMode(void);
 
+	//turn sprite batching on/off: when on, 2D sprites are drawn in batches instead of one at a time
+	void SetSpriteBatching(bool useBatching);
+	//turn the draw queue on/off: when on, 2D sprites and text are sorted by layer, blend mode and texture before drawing
+	void SetDrawQueue(bool useQueue);
+	//turn the draw queue's depth mode on/off: when on, sprites queued with BlendMode::SOLID are drawn first,
+	//front to back with depth writes and no blending, then everything else back to front. See DrawQueue.h
+	void SetDepthSorting2D(bool useDepth);
+	//draw anything the draw queue, sprite batch and instancer are holding; call before making your own OpenGL draw calls
+	void Flush(void);
+	//sends projectionMatrix, viewMatrix, renderTargetSize and frameTime to the frame uniform block, if any of them changed
+	void UpdateFrameUniforms(void);
+	//segments let worker threads build pre-transformed sprite quads in parallel;
+	//SubmitBatchSegment() must be called from the GL thread (inside Draw()), and clears the segment
+	SpriteBatchSegment *MakeBatchSegment(void);
+	void DeleteBatchSegment(SpriteBatchSegment *segment);
+	void SubmitBatchSegment(SpriteBatchSegment *segment);
+	//size of the streaming vertex ring, call before Run(); defaults to 3 frames of 4 MB
+	void SetStreamBufferSize(GLsizeiptr bytesPerFrame, int framesInFlight);
+
 	//methods for setting callbacks
 	void SetInit(void(*func)(void));
 	void SetUpdate(void(*func)(double));
@@ -0,0 +1,215 @@
+#include "Camera2D.h"
+
+extern logger oLog;
+
+Camera2D::Camera2D(Blit3D *blit3d)
+{
+	b3d = blit3d;
+
+	position = glm::vec2((float)b3d->screenWidth / 2.f, (float)b3d->screenHeight / 2.f);
+	zoom = 1.f;
+	angle = 0.f;
+	enabled = false;
+	dirty = true;
+
+	pendingPosition = position;
+	pendingZoom = zoom;
+	pendingAngle = angle;
+	pendingChanged = false;
+
+	view = glm::mat4(1.f);
+	minX = minY = maxX = maxY = 0.f;
+
+	visibleCount = culledCount = 0;
+	lastFrameVisibleCount = lastFrameCulledCount = 0;
+}
+
+void Camera2D::Enable(bool enable)
+{
+	if(enable == enabled) return;
+
+	b3d->Flush(); //sprites batched so far were meant for the old view
+	enabled = enable;
+
+	if(!enabled)
+	{
+		//hand the view back in the state Blit3D starts with
+		view = glm::mat4(1.f);
+		b3d->viewMatrix = view;
+		if(b3d->mode == Blit3DRenderMode::BLIT2D) b3d->UpdateFrameUniforms();
+	}
+
+	dirty = true;
+	Update();
+}
+
+void Camera2D::SetPosition(float x, float y)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pendingPosition = glm::vec2(x, y);
+	pendingChanged = true;
+}
+
+void Camera2D::Move(float dx, float dy)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pendingPosition += glm::vec2(dx, dy);
+	pendingChanged = true;
+}
+
+glm::vec2 Camera2D::GetPosition(void)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return pendingPosition;
+}
+
+void Camera2D::SetZoom(float newZoom)
+{
+	assert(newZoom > 0.f && "Camera2D zoom must be positive");
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pendingZoom = newZoom;
+	pendingChanged = true;
+}
+
+float Camera2D::GetZoom(void)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return pendingZoom;
+}
+
+void Camera2D::SetAngle(float degrees)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pendingAngle = degrees;
+	pendingChanged = true;
+}
+
+float Camera2D::GetAngle(void)
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return pendingAngle;
+}
+
+void Camera2D::Update(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		if(pendingChanged)
+		{
+			if(pendingPosition != position || pendingZoom != zoom || pendingAngle != angle) dirty = true;
+			position = pendingPosition;
+			zoom = pendingZoom;
+			angle = pendingAngle;
+			pendingChanged = false;
+		}
+	}
+
+	if(!dirty || !enabled || b3d->mode != Blit3DRenderMode::BLIT2D) return;
+
+	//anything batched so far gets drawn with the old view
+	b3d->Flush();
+
+	float halfW = (float)b3d->screenWidth / 2.f;
+	float halfH = (float)b3d->screenHeight / 2.f;
+
+	//move the camera position to the origin, zoom and rotate around it, then put it at the center of the screen
+	view = glm::translate(glm::mat4(1.f), glm::vec3(halfW, halfH, 0.f));
+	view = glm::rotate(view, glm::radians(-angle), glm::vec3(0.f, 0.f, 1.f));
+	view = glm::scale(view, glm::vec3(zoom, zoom, 1.f));
+	view = glm::translate(view, glm::vec3(-position.x, -position.y, 0.f));
+
+	//the screen rect in world space is a rotated rect around the camera position, take its bounding box
+	float c = fabsf(cosf(glm::radians(angle)));
+	float s = fabsf(sinf(glm::radians(angle)));
+	float extentX = (halfW * c + halfH * s) / zoom;
+	float extentY = (halfW * s + halfH * c) / zoom;
+	minX = position.x - extentX;
+	maxX = position.x + extentX;
+	minY = position.y - extentY;
+	maxY = position.y + extentY;
+
+	b3d->viewMatrix = view;
+
+	//every built-in shader reads the view from the frame uniform block
+	b3d->UpdateFrameUniforms();
+
+	dirty = false;
+}
+
+bool Camera2D::IsVisible(float x, float y, float radius)
+{
+	if(!enabled || b3d->mode != Blit3DRenderMode::BLIT2D) return true;
+
+	Update();
+
+	if(!IsVisibleNoUpdate(x, y, radius))
+	{
+		culledCount++;
+		return false;
+	}
+
+	visibleCount++;
+	return true;
+}
+
+bool Camera2D::IsVisibleNoUpdate(float x, float y, float radius) const
+{
+	if(!enabled || b3d->mode != Blit3DRenderMode::BLIT2D) return true;
+
+	return !(x + radius < minX || x - radius > maxX || y + radius < minY || y - radius > maxY);
+}
+
+void Camera2D::GetVisibleRect(float &left, float &bottom, float &right, float &top)
+{
+	if(enabled && b3d->mode == Blit3DRenderMode::BLIT2D)
+	{
+		Update();
+		left = minX;
+		bottom = minY;
+		right = maxX;
+		top = maxY;
+		return;
+	}
+
+	//someone else set the view, so take the bounding box of the screen corners in world space
+	glm::mat4 inverseView = glm::inverse(b3d->viewMatrix);
+	float w = (float)b3d->screenWidth;
+	float h = (float)b3d->screenHeight;
+	glm::vec4 corners[4] = {
+		inverseView * glm::vec4(0.f, 0.f, 0.f, 1.f),
+		inverseView * glm::vec4(w, 0.f, 0.f, 1.f),
+		inverseView * glm::vec4(0.f, h, 0.f, 1.f),
+		inverseView * glm::vec4(w, h, 0.f, 1.f)
+	};
+
+	left = right = corners[0].x;
+	bottom = top = corners[0].y;
+	for(int i = 1; i < 4; ++i)
+	{
+		left = glm::min(left, corners[i].x);
+		right = glm::max(right, corners[i].x);
+		bottom = glm::min(bottom, corners[i].y);
+		top = glm::max(top, corners[i].y);
+	}
+}
+
+glm::vec2 Camera2D::ScreenToWorld(float x, float y)
+{
+	Update();
+	glm::vec4 world = glm::inverse(view) * glm::vec4(x, y, 0.f, 1.f);
+	return glm::vec2(world.x, world.y);
+}
+
+glm::vec2 Camera2D::WorldToScreen(float x, float y)
+{
+	Update();
+	glm::vec4 screen = view * glm::vec4(x, y, 0.f, 1.f);
+	return glm::vec2(screen.x, screen.y);
+}
+
+void Camera2D::EndFrame(void)
+{
+	lastFrameVisibleCount = visibleCount;
+	lastFrameCulledCount = culledCount;
+	visibleCount = culledCount = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+/*
+	2D camera: position, zoom and rotation.
+
+	When enabled (blit3D->camera2d->Enable(true)), the camera owns Blit3D::viewMatrix in 2D mode.
+	The view matrix is only rebuilt when the camera (or the window size) changes, and any
+	sprites already batched are drawn with the old view first.
+
+	Sprite::Blit() and Sprite::BlitInstanced() test each sprite's bounding circle against the
+	visible rect and skip off-screen sprites before doing any other work. visibleCount and
+	culledCount report how many sprites passed/failed the test; lastFrame* are the totals for
+	the previous frame.
+
+	The setters can be called from any thread (the game's Update() thread, in the multithreaded
+	models): they only store the new values, and Update() applies them on the GL thread. Blit3D
+	calls Update() before Draw(), so a move shows up in the next frame drawn; if you move the camera
+	inside Draw(), the next IsVisible() or Blit() applies it.
+
+	Sprite::BlitToSegment() runs on worker threads, so it uses IsVisibleNoUpdate(), which only reads
+	the visible rect from the last Update() and counts nothing: each SpriteBatchSegment keeps its own
+	counts, which are added to ours when the segment is submitted.
+*/
+#include "Blit3D.h"
+#include <mutex>
+
+class Blit3D;
+
+class Camera2D
+{
+private:
+	glm::vec2 position; //world coordinates shown at the center of the screen
+	float zoom; //2 = everything twice as big
+	float angle; //rotation of the camera in degrees
+	bool enabled;
+	bool dirty; //view matrix needs rebuilding; GL thread only
+
+	//what the setters asked for, applied by the next Update()
+	mutable std::mutex pendingMutex;
+	glm::vec2 pendingPosition;
+	float pendingZoom;
+	float pendingAngle;
+	bool pendingChanged;
+
+	glm::mat4 view;
+	float minX, minY, maxX, maxY; //world-space rect that contains everything on screen
+
+	Blit3D *b3d;
+
+public:
+	int visibleCount, culledCount; //sprites tested so far this frame, including submitted segments; GL thread only
+	int lastFrameVisibleCount, lastFrameCulledCount;
+
+	Camera2D(Blit3D *blit3d);
+
+	void Enable(bool enable);
+	bool IsEnabled(void) { return enabled; }
+
+	//safe from any thread; the Get*() functions return the latest value set, even before Update() applies it
+	void SetPosition(float x, float y);
+	void Move(float dx, float dy);
+	glm::vec2 GetPosition(void);
+	void SetZoom(float newZoom);
+	float GetZoom(void);
+	void SetAngle(float degrees);
+	float GetAngle(void);
+
+	void MarkDirty(void) { dirty = true; } //Blit3D calls this when the window size changes
+	void Update(void); //apply the setters and rebuild the view matrix and visible rect if anything changed; GL thread only
+
+	//true if a circle at x,y with this radius is on screen; always true if the camera isn't in charge
+	bool IsVisible(float x, float y, float radius);
+	//same test for worker threads: uses the rect from the last Update() and doesn't count, the caller does
+	bool IsVisibleNoUpdate(float x, float y, float radius) const;
+	void AddCounts(int visible, int culled) { visibleCount += visible; culledCount += culled; } //GL thread only
+	//world-space rect that contains everything on screen; uses Blit3D::viewMatrix when the camera isn't in charge
+	void GetVisibleRect(float &left, float &bottom, float &right, float &top);
+
+	//converts window coordinates (e.g. the mouse) to world coordinates, and back
+	glm::vec2 ScreenToWorld(float x, float y);
+	glm::vec2 WorldToScreen(float x, float y);
+
+	void EndFrame(void); //called by Blit3D once per frame to roll the stats over
+};
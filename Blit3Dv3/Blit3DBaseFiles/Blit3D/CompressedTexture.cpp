@@ -0,0 +1,702 @@
+#include "CompressedTexture.h"
+#include "Logger.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <cctype>
+#include <stdint.h>
+
+extern logger oLog;
+
+namespace
+{
+	uint32_t Read32(const unsigned char *p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	uint64_t Read64(const unsigned char *p)
+	{
+		return (uint64_t)Read32(p) | ((uint64_t)Read32(p + 4) << 32);
+	}
+
+	size_t LevelSize(B3D::BlockFormat format, int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * B3D::BlockBytes(format);
+	}
+
+	bool EndsWith(const std::string &text, const char *suffix)
+	{
+		size_t length = strlen(suffix);
+		if(text.size() < length) return false;
+		for(size_t i = 0; i < length; ++i)
+		{
+			if(tolower((unsigned char)text[text.size() - length + i]) != suffix[i]) return false;
+		}
+		return true;
+	}
+
+	//copies the levels out of the file, checking each one is really there
+	bool AddLevel(B3D::CompressedImage &image, const std::vector<unsigned char> &file, size_t offset, size_t size, const std::string &filename)
+	{
+		int level = (int)image.levels.size();
+		B3D::CompressedLevel info;
+		info.width = std::max(1, image.width >> level);
+		info.height = std::max(1, image.height >> level);
+		info.size = LevelSize(image.format, info.width, info.height);
+		info.offset = image.data.size();
+
+		if(size < info.size || offset + info.size > file.size())
+		{
+			oLog(Level::Severe) << "Compressed texture " << filename << " is truncated at mip level " << level;
+			return false;
+		}
+
+		image.data.insert(image.data.end(), file.begin() + offset, file.begin() + offset + info.size);
+		image.levels.push_back(info);
+		return true;
+	}
+
+	//the three bits of each row's indices sit in one 12-bit group; reverse the first rows groups
+	void FlipAlphaBlock(unsigned char *block, int rows)
+	{
+		uint64_t bits = 0;
+		for(int i = 0; i < 6; ++i) bits |= (uint64_t)block[2 + i] << (8 * i);
+
+		uint64_t flipped = 0;
+		for(int row = 0; row < 4; ++row)
+		{
+			int source = row < rows ? rows - 1 - row : row;
+			flipped |= ((bits >> (12 * source)) & 0xFFF) << (12 * row);
+		}
+
+		for(int i = 0; i < 6; ++i) block[2 + i] = (unsigned char)(flipped >> (8 * i));
+	}
+
+	//one index byte per row
+	void FlipColorBlock(unsigned char *block, int rows)
+	{
+		for(int i = 0; i < rows / 2; ++i) std::swap(block[4 + i], block[4 + rows - 1 - i]);
+	}
+
+	//two bytes of explicit alpha per row
+	void FlipExplicitAlphaBlock(unsigned char *block, int rows)
+	{
+		for(int i = 0; i < rows / 2; ++i)
+		{
+			std::swap(block[2 * i], block[2 * (rows - 1 - i)]);
+			std::swap(block[2 * i + 1], block[2 * (rows - 1 - i) + 1]);
+		}
+	}
+
+	//turns every level upside down: the rows inside each block, then the order of the block rows
+	bool FlipBlocks(B3D::CompressedImage &image)
+	{
+		using B3D::BlockFormat;
+		if(image.format == BlockFormat::BC6H_UNSIGNED || image.format == BlockFormat::BC6H_SIGNED || image.format == BlockFormat::BC7) return false;
+
+		int blockBytes = B3D::BlockBytes(image.format);
+
+		for(const B3D::CompressedLevel &level : image.levels)
+		{
+			int blocksX = (level.width + 3) / 4;
+			int blocksY = (level.height + 3) / 4;
+			int rows = std::min(level.height, 4); //a level less than a block tall only has this many real rows
+			unsigned char *data = image.data.data() + level.offset;
+
+			for(int i = 0; i < blocksX * blocksY; ++i)
+			{
+				unsigned char *block = data + (size_t)i * blockBytes;
+				switch(image.format)
+				{
+				case BlockFormat::BC1_RGB:
+				case BlockFormat::BC1_RGBA:
+					FlipColorBlock(block, rows);
+					break;
+				case BlockFormat::BC2:
+					FlipExplicitAlphaBlock(block, rows);
+					FlipColorBlock(block + 8, rows);
+					break;
+				case BlockFormat::BC3:
+					FlipAlphaBlock(block, rows);
+					FlipColorBlock(block + 8, rows);
+					break;
+				case BlockFormat::BC4:
+				case BlockFormat::BC4_SIGNED:
+					FlipAlphaBlock(block, rows);
+					break;
+				case BlockFormat::BC5:
+				case BlockFormat::BC5_SIGNED:
+					FlipAlphaBlock(block, rows);
+					FlipAlphaBlock(block + 8, rows);
+					break;
+				default:
+					break;
+				}
+			}
+
+			size_t rowBytes = (size_t)blocksX * blockBytes;
+			std::vector<unsigned char> swapRow(rowBytes);
+			for(int y = 0; y < blocksY / 2; ++y)
+			{
+				unsigned char *top = data + y * rowBytes;
+				unsigned char *bottom = data + (blocksY - 1 - y) * rowBytes;
+				memcpy(swapRow.data(), top, rowBytes);
+				memcpy(top, bottom, rowBytes);
+				memcpy(bottom, swapRow.data(), rowBytes);
+			}
+		}
+
+		return true;
+	}
+
+	//KTX and KTX2 share the key/value layout; returns the value of key, or "" if it isn't there
+	std::string FindKeyValue(const std::vector<unsigned char> &file, size_t offset, size_t length, const char *key)
+	{
+		size_t end = std::min(offset + length, file.size());
+		while(offset + 4 <= end)
+		{
+			uint32_t size = Read32(&file[offset]);
+			size_t start = offset + 4;
+			if(start + size > end) break;
+
+			const char *pair = (const char *)&file[start];
+			size_t keyLength = strnlen(pair, size);
+			if(keyLength < size && strcmp(pair, key) == 0)
+			{
+				const char *value = pair + keyLength + 1;
+				return std::string(value, strnlen(value, size - keyLength - 1));
+			}
+
+			offset = start + ((size + 3) & ~(size_t)3);
+		}
+		return "";
+	}
+
+	bool ReadDDS(const std::string &filename, const std::vector<unsigned char> &file, B3D::CompressedImage &image)
+	{
+		using B3D::BlockFormat;
+
+		if(file.size() < 128 || memcmp(file.data(), "DDS ", 4) != 0)
+		{
+			oLog(Level::Severe) << filename << " is not a DDS file";
+			return false;
+		}
+
+		image.height = (int)Read32(&file[12]);
+		image.width = (int)Read32(&file[16]);
+		int levelCount = std::max(1, (int)Read32(&file[28]));
+		uint32_t pixelFlags = Read32(&file[80]);
+		const char *fourCC = (const char *)&file[84];
+		uint32_t caps2 = Read32(&file[112]);
+		size_t offset = 128;
+
+		if(caps2 & (0x200 | 0x200000))
+		{
+			oLog(Level::Severe) << filename << ": cube map and volume DDS files aren't supported";
+			return false;
+		}
+		if(!(pixelFlags & 0x4))
+		{
+			oLog(Level::Severe) << filename << ": uncompressed DDS files aren't supported, use a PNG";
+			return false;
+		}
+
+		if(memcmp(fourCC, "DX10", 4) == 0)
+		{
+			if(file.size() < 148)
+			{
+				oLog(Level::Severe) << filename << " is truncated";
+				return false;
+			}
+
+			uint32_t dxgiFormat = Read32(&file[128]);
+			uint32_t dimension = Read32(&file[132]);
+			uint32_t miscFlag = Read32(&file[136]);
+			uint32_t arraySize = Read32(&file[140]);
+			offset = 148;
+
+			if(dimension != 3 || (miscFlag & 0x4) || arraySize > 1)
+			{
+				oLog(Level::Severe) << filename << ": only single 2D textures are supported";
+				return false;
+			}
+
+			switch(dxgiFormat)
+			{
+			case 70: case 71: case 72: image.format = BlockFormat::BC1_RGBA; break;
+			case 73: case 74: case 75: image.format = BlockFormat::BC2; break;
+			case 76: case 77: case 78: image.format = BlockFormat::BC3; break;
+			case 79: case 80: image.format = BlockFormat::BC4; break;
+			case 81: image.format = BlockFormat::BC4_SIGNED; break;
+			case 82: case 83: image.format = BlockFormat::BC5; break;
+			case 84: image.format = BlockFormat::BC5_SIGNED; break;
+			case 94: case 95: image.format = BlockFormat::BC6H_UNSIGNED; break;
+			case 96: image.format = BlockFormat::BC6H_SIGNED; break;
+			case 97: case 98: case 99: image.format = BlockFormat::BC7; break;
+			default:
+				oLog(Level::Severe) << filename << ": DXGI format " << dxgiFormat << " isn't a BCn format";
+				return false;
+			}
+		}
+		else if(memcmp(fourCC, "DXT1", 4) == 0) image.format = BlockFormat::BC1_RGBA;
+		else if(memcmp(fourCC, "DXT2", 4) == 0 || memcmp(fourCC, "DXT3", 4) == 0) image.format = BlockFormat::BC2;
+		else if(memcmp(fourCC, "DXT4", 4) == 0 || memcmp(fourCC, "DXT5", 4) == 0) image.format = BlockFormat::BC3;
+		else if(memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0) image.format = BlockFormat::BC4;
+		else if(memcmp(fourCC, "BC4S", 4) == 0) image.format = BlockFormat::BC4_SIGNED;
+		else if(memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0) image.format = BlockFormat::BC5;
+		else if(memcmp(fourCC, "BC5S", 4) == 0) image.format = BlockFormat::BC5_SIGNED;
+		else
+		{
+			oLog(Level::Severe) << filename << ": DDS FourCC " << std::string(fourCC, 4) << " isn't supported";
+			return false;
+		}
+
+		//levels are stored one after the other, largest first
+		for(int level = 0; level < levelCount; ++level)
+		{
+			size_t size = LevelSize(image.format, std::max(1, image.width >> level), std::max(1, image.height >> level));
+			if(!AddLevel(image, file, offset, size, filename)) return false;
+			offset += size;
+		}
+
+		return true;
+	}
+
+	bool FormatFromGL(uint32_t internalFormat, B3D::BlockFormat &format)
+	{
+		using B3D::BlockFormat;
+		switch(internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: format = BlockFormat::BC1_RGB; return true;
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: format = BlockFormat::BC1_RGBA; return true;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: format = BlockFormat::BC2; return true;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: format = BlockFormat::BC3; return true;
+		case GL_COMPRESSED_RED_RGTC1: format = BlockFormat::BC4; return true;
+		case GL_COMPRESSED_SIGNED_RED_RGTC1: format = BlockFormat::BC4_SIGNED; return true;
+		case GL_COMPRESSED_RG_RGTC2: format = BlockFormat::BC5; return true;
+		case GL_COMPRESSED_SIGNED_RG_RGTC2: format = BlockFormat::BC5_SIGNED; return true;
+		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: format = BlockFormat::BC6H_UNSIGNED; return true;
+		case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT: format = BlockFormat::BC6H_SIGNED; return true;
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: format = BlockFormat::BC7; return true;
+		}
+		return false;
+	}
+
+	bool ReadKTX(const std::string &filename, const std::vector<unsigned char> &file, B3D::CompressedImage &image, bool &bottomUp)
+	{
+		if(file.size() < 64 || Read32(&file[12]) != 0x04030201)
+		{
+			oLog(Level::Severe) << filename << " is truncated or big-endian, neither is supported";
+			return false;
+		}
+
+		uint32_t glType = Read32(&file[16]);
+		uint32_t internalFormat = Read32(&file[28]);
+		image.width = (int)Read32(&file[36]);
+		image.height = (int)Read32(&file[40]);
+		uint32_t depth = Read32(&file[44]);
+		uint32_t arrayElements = Read32(&file[48]);
+		uint32_t faces = Read32(&file[52]);
+		int levelCount = std::max(1, (int)Read32(&file[56]));
+		uint32_t keyValueBytes = Read32(&file[60]);
+
+		if(glType != 0 || !FormatFromGL(internalFormat, image.format))
+		{
+			oLog(Level::Severe) << filename << ": only BCn compressed KTX files are supported";
+			return false;
+		}
+		if(image.height == 0 || depth > 0 || arrayElements > 0 || faces != 1)
+		{
+			oLog(Level::Severe) << filename << ": only single 2D textures are supported";
+			return false;
+		}
+
+		//"S=r,T=u" means rows already run bottom to top, like OpenGL
+		std::string orientation = FindKeyValue(file, 64, keyValueBytes, "KTXorientation");
+		bottomUp = orientation.find("T=u") != std::string::npos;
+
+		size_t offset = 64 + (size_t)keyValueBytes;
+		for(int level = 0; level < levelCount; ++level)
+		{
+			if(offset + 4 > file.size())
+			{
+				oLog(Level::Severe) << "Compressed texture " << filename << " is truncated at mip level " << level;
+				return false;
+			}
+
+			uint32_t imageSize = Read32(&file[offset]);
+			if(!AddLevel(image, file, offset + 4, imageSize, filename)) return false;
+			offset += 4 + (((size_t)imageSize + 3) & ~(size_t)3);
+		}
+
+		return true;
+	}
+
+	bool ReadKTX2(const std::string &filename, const std::vector<unsigned char> &file, B3D::CompressedImage &image, bool &bottomUp)
+	{
+		using B3D::BlockFormat;
+
+		if(file.size() < 80)
+		{
+			oLog(Level::Severe) << filename << " is truncated";
+			return false;
+		}
+
+		uint32_t vkFormat = Read32(&file[12]);
+		image.width = (int)Read32(&file[20]);
+		image.height = (int)Read32(&file[24]);
+		uint32_t depth = Read32(&file[28]);
+		uint32_t layers = Read32(&file[32]);
+		uint32_t faces = Read32(&file[36]);
+		int levelCount = std::max(1, (int)Read32(&file[40]));
+		uint32_t supercompression = Read32(&file[44]);
+		uint32_t keyValueOffset = Read32(&file[56]);
+		uint32_t keyValueBytes = Read32(&file[60]);
+
+		switch(vkFormat)
+		{
+		case 131: case 132: image.format = BlockFormat::BC1_RGB; break;
+		case 133: case 134: image.format = BlockFormat::BC1_RGBA; break;
+		case 135: case 136: image.format = BlockFormat::BC2; break;
+		case 137: case 138: image.format = BlockFormat::BC3; break;
+		case 139: image.format = BlockFormat::BC4; break;
+		case 140: image.format = BlockFormat::BC4_SIGNED; break;
+		case 141: image.format = BlockFormat::BC5; break;
+		case 142: image.format = BlockFormat::BC5_SIGNED; break;
+		case 143: image.format = BlockFormat::BC6H_UNSIGNED; break;
+		case 144: image.format = BlockFormat::BC6H_SIGNED; break;
+		case 145: case 146: image.format = BlockFormat::BC7; break;
+		default:
+			oLog(Level::Severe) << filename << ": Vulkan format " << vkFormat << " isn't a BCn format";
+			return false;
+		}
+
+		if(supercompression != 0)
+		{
+			oLog(Level::Severe) << filename << ": supercompressed (Basis/zstd) KTX2 files aren't supported";
+			return false;
+		}
+		if(image.height == 0 || depth > 0 || layers > 0 || faces != 1)
+		{
+			oLog(Level::Severe) << filename << ": only single 2D textures are supported";
+			return false;
+		}
+		if(file.size() < 80 + (size_t)levelCount * 24)
+		{
+			oLog(Level::Severe) << filename << " is truncated";
+			return false;
+		}
+
+		//"rd" (the default) is top to bottom, "ru" bottom to top
+		std::string orientation = FindKeyValue(file, keyValueOffset, keyValueBytes, "KTXorientation");
+		bottomUp = orientation.size() > 1 && orientation[1] == 'u';
+
+		//the level index starts with level 0, the largest
+		for(int level = 0; level < levelCount; ++level)
+		{
+			const unsigned char *entry = &file[80 + (size_t)level * 24];
+			size_t offset = (size_t)Read64(entry);
+			size_t size = (size_t)Read64(entry + 8);
+			if(!AddLevel(image, file, offset, size, filename)) return false;
+		}
+
+		return true;
+	}
+
+	//4 RGBA colors from the two 565 endpoints; threeColor is BC1's mode with a transparent fourth color
+	void DecodeColorBlock(const unsigned char *block, unsigned char out[16][4], bool allowThreeColor, bool transparentBlack)
+	{
+		uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+		uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+
+		int colors[4][4];
+		uint16_t ends[2] = { c0, c1 };
+		for(int i = 0; i < 2; ++i)
+		{
+			int r = (ends[i] >> 11) & 31, g = (ends[i] >> 5) & 63, b = ends[i] & 31;
+			colors[i][0] = (r << 3) | (r >> 2);
+			colors[i][1] = (g << 2) | (g >> 4);
+			colors[i][2] = (b << 3) | (b >> 2);
+			colors[i][3] = 255;
+		}
+
+		if(c0 > c1 || !allowThreeColor)
+		{
+			for(int c = 0; c < 3; ++c)
+			{
+				colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+				colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+			}
+			colors[2][3] = colors[3][3] = 255;
+		}
+		else
+		{
+			for(int c = 0; c < 3; ++c)
+			{
+				colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+				colors[3][c] = 0;
+			}
+			colors[2][3] = 255;
+			colors[3][3] = transparentBlack ? 0 : 255;
+		}
+
+		uint32_t indices = Read32(block + 4);
+		for(int i = 0; i < 16; ++i)
+		{
+			int index = (indices >> (2 * i)) & 3;
+			for(int c = 0; c < 4; ++c) out[i][c] = (unsigned char)colors[index][c];
+		}
+	}
+
+	//BC3 alpha and BC4/BC5 channels: two endpoints and 3-bit indices
+	void DecodeAlphaBlock(const unsigned char *block, unsigned char out[16])
+	{
+		int a0 = block[0], a1 = block[1];
+		int values[8] = { a0, a1 };
+		if(a0 > a1)
+		{
+			for(int j = 1; j <= 6; ++j) values[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+		}
+		else
+		{
+			for(int j = 1; j <= 4; ++j) values[j + 1] = ((5 - j) * a0 + j * a1) / 5;
+			values[6] = 0;
+			values[7] = 255;
+		}
+
+		uint64_t bits = 0;
+		for(int i = 0; i < 6; ++i) bits |= (uint64_t)block[2 + i] << (8 * i);
+		for(int i = 0; i < 16; ++i) out[i] = (unsigned char)values[(bits >> (3 * i)) & 7];
+	}
+}
+
+bool B3D::IsCompressedTextureFile(const std::string &filename)
+{
+	return EndsWith(filename, ".dds") || EndsWith(filename, ".ktx") || EndsWith(filename, ".ktx2");
+}
+
+bool B3D::ReadCompressedTexture(const std::string &filename, CompressedImage &image)
+{
+	std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+	if(!ifs.is_open())
+	{
+		oLog(Level::Severe) << "Can't open compressed texture: " << filename;
+		return false;
+	}
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+	static const unsigned char ktx1Id[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	static const unsigned char ktx2Id[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	image.levels.clear();
+	image.data.clear();
+
+	bool bottomUp = false; //DDS is always top to bottom
+	bool ok;
+	if(file.size() >= 12 && memcmp(file.data(), ktx1Id, 12) == 0) ok = ReadKTX(filename, file, image, bottomUp);
+	else if(file.size() >= 12 && memcmp(file.data(), ktx2Id, 12) == 0) ok = ReadKTX2(filename, file, image, bottomUp);
+	else ok = ReadDDS(filename, file, image);
+
+	if(!ok) return false;
+	if(image.width <= 0 || image.height <= 0)
+	{
+		oLog(Level::Severe) << filename << " has no size";
+		return false;
+	}
+
+	if(!bottomUp)
+	{
+		if(!FlipBlocks(image))
+		{
+			oLog(Level::Warning) << filename << ": " << BlockFormatName(image.format)
+				<< " blocks can't be flipped, so it will show upside down unless it was exported flipped vertically";
+		}
+		else
+		{
+			//blocks can only be moved whole, so any level that ends in a partial block row comes out shifted;
+			//mips of a multiple-of-4 image can still hit this (e.g. 540 -> 135 -> 67 -> 33)
+			size_t firstShifted = image.levels.size();
+			for(size_t i = 0; i < image.levels.size(); ++i)
+			{
+				int levelHeight = image.levels[i].height;
+				if(levelHeight % 4 != 0 && levelHeight > 4)
+				{
+					firstShifted = i;
+					break;
+				}
+			}
+
+			if(firstShifted == 0)
+			{
+				oLog(Level::Warning) << filename << ": height " << image.height << " isn't a multiple of 4, so flipping it shifts it by "
+					<< 4 - image.height % 4 << " rows";
+			}
+			else if(firstShifted < image.levels.size())
+			{
+				//the upload sets GL_TEXTURE_MAX_LEVEL from the level count, so a shorter chain is still complete
+				oLog(Level::Warning) << filename << ": dropping mip levels " << firstShifted << " to " << image.levels.size() - 1
+					<< ", level " << firstShifted << " is " << image.levels[firstShifted].height << " rows tall and would come out shifted";
+				image.levels.resize(firstShifted);
+			}
+		}
+	}
+
+	return true;
+}
+
+const char *B3D::BlockFormatName(BlockFormat format)
+{
+	switch(format)
+	{
+	case BlockFormat::BC1_RGB: return "BC1 (RGB)";
+	case BlockFormat::BC1_RGBA: return "BC1";
+	case BlockFormat::BC2: return "BC2";
+	case BlockFormat::BC3: return "BC3";
+	case BlockFormat::BC4: return "BC4";
+	case BlockFormat::BC4_SIGNED: return "BC4 (signed)";
+	case BlockFormat::BC5: return "BC5";
+	case BlockFormat::BC5_SIGNED: return "BC5 (signed)";
+	case BlockFormat::BC6H_UNSIGNED: return "BC6H";
+	case BlockFormat::BC6H_SIGNED: return "BC6H (signed)";
+	case BlockFormat::BC7: return "BC7";
+	}
+	return "unknown";
+}
+
+int B3D::BlockBytes(BlockFormat format)
+{
+	switch(format)
+	{
+	case BlockFormat::BC1_RGB:
+	case BlockFormat::BC1_RGBA:
+	case BlockFormat::BC4:
+	case BlockFormat::BC4_SIGNED:
+		return 8;
+	default:
+		return 16;
+	}
+}
+
+GLenum B3D::CompressedGLFormat(BlockFormat format)
+{
+	switch(format)
+	{
+	case BlockFormat::BC1_RGB: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BlockFormat::BC1_RGBA: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BlockFormat::BC2: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BlockFormat::BC4_SIGNED: return GL_COMPRESSED_SIGNED_RED_RGTC1;
+	case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+	case BlockFormat::BC5_SIGNED: return GL_COMPRESSED_SIGNED_RG_RGTC2;
+	case BlockFormat::BC6H_UNSIGNED: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+	case BlockFormat::BC6H_SIGNED: return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+	case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+	return 0;
+}
+
+bool B3D::CompressedFormatSupported(BlockFormat format)
+{
+	switch(format)
+	{
+	case BlockFormat::BC1_RGB:
+	case BlockFormat::BC1_RGBA:
+	case BlockFormat::BC2:
+	case BlockFormat::BC3:
+		return GLEW_EXT_texture_compression_s3tc != 0;
+	case BlockFormat::BC4:
+	case BlockFormat::BC4_SIGNED:
+	case BlockFormat::BC5:
+	case BlockFormat::BC5_SIGNED:
+		return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+	default:
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	}
+}
+
+bool B3D::DecompressLevel(const CompressedImage &image, int level, std::vector<unsigned char> &rgba)
+{
+	switch(image.format)
+	{
+	case BlockFormat::BC4_SIGNED:
+	case BlockFormat::BC5_SIGNED:
+	case BlockFormat::BC6H_UNSIGNED:
+	case BlockFormat::BC6H_SIGNED:
+	case BlockFormat::BC7:
+		return false;
+	default:
+		break;
+	}
+
+	const CompressedLevel &info = image.levels[level];
+	const unsigned char *data = image.data.data() + info.offset;
+	int blockBytes = BlockBytes(image.format);
+	int blocksX = (info.width + 3) / 4;
+	int blocksY = (info.height + 3) / 4;
+
+	rgba.assign((size_t)info.width * info.height * 4, 0);
+
+	unsigned char pixels[16][4];
+	unsigned char channel[16];
+
+	for(int by = 0; by < blocksY; ++by)
+	{
+		for(int bx = 0; bx < blocksX; ++bx)
+		{
+			const unsigned char *block = data + ((size_t)by * blocksX + bx) * blockBytes;
+
+			switch(image.format)
+			{
+			case BlockFormat::BC1_RGB:
+			case BlockFormat::BC1_RGBA:
+				DecodeColorBlock(block, pixels, true, image.format == BlockFormat::BC1_RGBA);
+				break;
+			case BlockFormat::BC2:
+				DecodeColorBlock(block + 8, pixels, false, false);
+				for(int i = 0; i < 16; ++i) pixels[i][3] = (unsigned char)(((block[i / 2] >> (4 * (i & 1))) & 15) * 17);
+				break;
+			case BlockFormat::BC3:
+				DecodeColorBlock(block + 8, pixels, false, false);
+				DecodeAlphaBlock(block, channel);
+				for(int i = 0; i < 16; ++i) pixels[i][3] = channel[i];
+				break;
+			case BlockFormat::BC4:
+				DecodeAlphaBlock(block, channel);
+				for(int i = 0; i < 16; ++i)
+				{
+					pixels[i][0] = channel[i];
+					pixels[i][1] = pixels[i][2] = 0;
+					pixels[i][3] = 255;
+				}
+				break;
+			case BlockFormat::BC5:
+				DecodeAlphaBlock(block, channel);
+				for(int i = 0; i < 16; ++i) pixels[i][0] = channel[i];
+				DecodeAlphaBlock(block + 8, channel);
+				for(int i = 0; i < 16; ++i)
+				{
+					pixels[i][1] = channel[i];
+					pixels[i][2] = 0;
+					pixels[i][3] = 255;
+				}
+				break;
+			default:
+				return false;
+			}
+
+			//blocks past the right or top edge are only partly real
+			for(int row = 0; row < 4 && by * 4 + row < info.height; ++row)
+			{
+				for(int col = 0; col < 4 && bx * 4 + col < info.width; ++col)
+				{
+					memcpy(&rgba[(((size_t)by * 4 + row) * info.width + bx * 4 + col) * 4], pixels[row * 4 + col], 4);
+				}
+			}
+		}
+	}
+
+	return true;
+}
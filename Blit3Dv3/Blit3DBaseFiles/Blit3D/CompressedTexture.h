@@ -0,0 +1,53 @@
+#pragma once
+/*
+	Readers for GPU-compressed texture containers: DDS (legacy FourCC and DX10 headers), KTX and KTX2.
+
+	Only 2D textures holding BCn blocks are understood: BC1 (DXT1), BC2 (DXT3), BC3 (DXT5), BC4, BC5,
+	BC6H and BC7, with all their stored mip levels. Cube maps, arrays, uncompressed formats and
+	supercompressed (Basis/zstd) KTX2 files are refused with a log message.
+
+	Blit3D keeps textures bottom row first (stb flips PNGs as it loads them), so BC1-BC5 blocks are
+	flipped the same way while reading, unless the file says it is stored bottom-up already. BC6H and
+	BC7 blocks can't be flipped cheaply: export those upside down (a warning is logged).
+
+	sRGB variants are uploaded as their plain UNORM twins, so compressed textures look the same as the
+	PNG path, which does no gamma conversion either.
+
+	Reading is file I/O only, no OpenGL, so the async loaders call it on worker threads. TextureManager
+	does the upload, falling back to DecompressLevel() (BC1-BC5) if the driver lacks the format.
+*/
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+namespace B3D
+{
+	enum class BlockFormat { BC1_RGB, BC1_RGBA, BC2, BC3, BC4, BC4_SIGNED, BC5, BC5_SIGNED, BC6H_UNSIGNED, BC6H_SIGNED, BC7 };
+
+	class CompressedLevel
+	{
+	public:
+		int width, height; //in pixels
+		size_t offset, size; //into CompressedImage::data
+	};
+
+	class CompressedImage
+	{
+	public:
+		BlockFormat format;
+		int width, height; //of level 0
+		std::vector<CompressedLevel> levels; //largest first
+		std::vector<unsigned char> data;
+	};
+
+	bool IsCompressedTextureFile(const std::string &filename); //by extension: .dds, .ktx or .ktx2
+	//reads the container and flips the blocks bottom-up; returns false (and logs why) if it can't
+	bool ReadCompressedTexture(const std::string &filename, CompressedImage &image);
+
+	const char *BlockFormatName(BlockFormat format);
+	int BlockBytes(BlockFormat format); //bytes per 4x4 block
+	GLenum CompressedGLFormat(BlockFormat format);
+	bool CompressedFormatSupported(BlockFormat format); //asks the driver, GL thread only
+	//CPU decode of one level to RGBA8, for drivers that lack the format; BC1-BC5 (unsigned) only
+	bool DecompressLevel(const CompressedImage &image, int level, std::vector<unsigned char> &rgba);
+}
@@ -0,0 +1,290 @@
+#include "DrawQueue.h"
+
+extern logger oLog;
+
+void B3D::BlendModeFunc(BlendMode mode, GLenum &src, GLenum &dst)
+{
+	switch(mode)
+	{
+	case BlendMode::ADDITIVE:
+		src = GL_SRC_ALPHA;
+		dst = GL_ONE;
+		break;
+
+	case BlendMode::MULTIPLY:
+		src = GL_DST_COLOR;
+		dst = GL_ONE_MINUS_SRC_ALPHA;
+		break;
+
+	case BlendMode::PREMULTIPLIED:
+		src = GL_ONE;
+		dst = GL_ONE_MINUS_SRC_ALPHA;
+		break;
+
+	case BlendMode::SOLID:
+		src = GL_ONE;
+		dst = GL_ZERO;
+		break;
+
+	default: //ALPHA, the Blit3D default
+		src = GL_SRC_ALPHA;
+		dst = GL_ONE_MINUS_SRC_ALPHA;
+		break;
+	}
+}
+
+DrawQueue::DrawQueue(SpriteBatch *spriteBatch)
+{
+	batch = spriteBatch;
+	active = false;
+	depthMode = false;
+	opaqueCount = lastFrameOpaqueCount = 0;
+
+	shaders.push_back(NULL); //built-in batch shader
+	currentShader = 0;
+	currentBlend = B3D::BlendMode::ALPHA;
+
+	commandCount = lastFrameCommandCount = 0;
+
+	keys.reserve(SPRITEBATCH_MAX_QUADS);
+	commands.reserve(SPRITEBATCH_MAX_QUADS);
+	zValues.reserve(SPRITEBATCH_MAX_QUADS);
+}
+
+void DrawQueue::SetShader(GLSLProgram *shader)
+{
+	for(int i = 0; i < (int)shaders.size(); ++i)
+	{
+		if(shaders[i] == shader)
+		{
+			currentShader = i;
+			return;
+		}
+	}
+
+	assert(shaders.size() < 256 && "DrawQueue: too many shaders, the sort key only has 8 bits for them");
+	shaders.push_back(shader);
+	currentShader = (int)shaders.size() - 1;
+}
+
+void DrawQueue::SetBlendMode(B3D::BlendMode mode)
+{
+	assert(mode < B3D::BlendMode::COUNT);
+	currentBlend = mode;
+}
+
+void DrawQueue::Submit(int layer, float depth, const B3D::DrawCommand &command)
+{
+	//clamp to what fits in the key
+	if(layer < 0) layer = 0;
+	else if(layer > 255) layer = 255;
+	if(depth < 0.f) depth = 0.f;
+	else if(depth > 1.f) depth = 1.f;
+
+	bool opaque = depthMode && currentBlend == B3D::BlendMode::SOLID;
+
+	//back (depth 1) has to sort first, unless we are opaque: then the front goes first
+	uint64_t layerBits = opaque ? 255 - layer : layer;
+	uint64_t depthBits = (uint64_t)((opaque ? depth : 1.f - depth) * 65535.f);
+
+	uint64_t key = (layerBits << 56)
+		| ((uint64_t)currentShader << 48)
+		| ((uint64_t)currentBlend << 40)
+		| (((uint64_t)command.texture & 0xFFFFFF) << 16)
+		| depthBits;
+
+	float z = 0.f;
+	if(depthMode)
+	{
+		if(opaque)
+		{
+			//the opaque pass sorts first; the depth buffer sorts out overlaps, so it stays texture-major
+			key >>= 1;
+		}
+		else
+		{
+			//nothing corrects blending order, so depth goes right under the layer: back to front across textures
+			key = ((uint64_t)1 << 63)
+				| (layerBits << 55)
+				| (depthBits << 39)
+				| ((uint64_t)currentShader << 31)
+				| ((uint64_t)currentBlend << 23)
+				| ((uint64_t)command.texture & 0x7FFFFF);
+		}
+
+		//back of layer 0 at -1 (the far plane of the 2D projection), front of layer 255 near 0
+		z = ((float)layer + (1.f - depth) * 0.99f) / 256.f - 1.f;
+	}
+
+	keys.push_back(key);
+	commands.push_back(command);
+	zValues.push_back(z);
+}
+
+void DrawQueue::RadixSort(void)
+{
+	size_t count = keys.size();
+
+	sortKeys.assign(keys.begin(), keys.end());
+	sortKeysTemp.resize(count);
+	sortIndices.resize(count);
+	sortIndicesTemp.resize(count);
+	for(uint32_t i = 0; i < count; ++i) sortIndices[i] = i;
+
+	//one histogram per byte of the key, all built in a single pass over the keys
+	uint32_t histograms[8][256] = {};
+	for(size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = sortKeys[i];
+		for(int b = 0; b < 8; ++b) histograms[b][(key >> (b * 8)) & 0xFF]++;
+	}
+
+	//LSD: least significant byte first, each pass is a stable counting sort
+	for(int b = 0; b < 8; ++b)
+	{
+		uint32_t *histogram = histograms[b];
+
+		//every key has the same value in this byte, nothing to do
+		if(histogram[(sortKeys[0] >> (b * 8)) & 0xFF] == count) continue;
+
+		uint32_t offsets[256];
+		uint32_t total = 0;
+		for(int i = 0; i < 256; ++i)
+		{
+			offsets[i] = total;
+			total += histogram[i];
+		}
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			uint32_t slot = offsets[(sortKeys[i] >> (b * 8)) & 0xFF]++;
+			sortKeysTemp[slot] = sortKeys[i];
+			sortIndicesTemp[slot] = sortIndices[i];
+		}
+
+		sortKeys.swap(sortKeysTemp);
+		sortIndices.swap(sortIndicesTemp);
+	}
+}
+
+void DrawQueue::Flush(void)
+{
+	if(commands.empty()) return;
+
+	RadixSort();
+
+	//leave the batch the way we found it
+	GLSLProgram *previousShader = batch->GetShader();
+	GLenum previousSrc, previousDst;
+	batch->GetBlendFunc(previousSrc, previousDst);
+
+	int shader = -1;
+	int blend = -1;
+	GLuint texture = 0;
+
+	//in depth mode the key has the pass in its top bit; the opaque pass keeps the usual layout one bit
+	//lower, the blended pass has depth under the layer, then shader and blend
+	int shaderShift = depthMode ? 47 : 48;
+	int blendShift = depthMode ? 39 : 40;
+	bool opaquePass = false;
+
+	if(depthMode)
+	{
+		opaquePass = (sortKeys[0] >> 63) == 0;
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(opaquePass ? GL_TRUE : GL_FALSE);
+		if(opaquePass) glDisable(GL_BLEND);
+	}
+
+	for(size_t i = 0; i < sortIndices.size(); ++i)
+	{
+		uint64_t key = sortKeys[i];
+		uint32_t index = sortIndices[i];
+		B3D::DrawCommand &c = commands[index];
+
+		if(opaquePass && (key >> 63) != 0)
+		{
+			//the opaque pass is done, the rest blends on top of it
+			DrawRun(texture);
+			batch->Flush();
+			opaqueCount += (int)i;
+
+			opaquePass = false;
+			glDepthMask(GL_FALSE);
+			glEnable(GL_BLEND);
+		}
+		if(depthMode && !opaquePass)
+		{
+			shaderShift = 31;
+			blendShift = 23;
+		}
+
+		//only touch state when the key says it changed; the batch flushes for us when it does
+		int keyShader = (int)((key >> shaderShift) & 0xFF);
+		int keyBlend = (int)((key >> blendShift) & 0xFF);
+
+		if(keyShader != shader || keyBlend != blend || c.texture != texture)
+		{
+			//everything gathered so far shares the old state
+			DrawRun(texture);
+
+			if(keyShader != shader)
+			{
+				shader = keyShader;
+				batch->SetShader(shaders[shader] ? shaders[shader] : previousShader);
+			}
+
+			if(keyBlend != blend)
+			{
+				blend = keyBlend;
+				GLenum src, dst;
+				B3D::BlendModeFunc((B3D::BlendMode)blend, src, dst);
+				batch->SetBlendFunc(src, dst);
+			}
+
+			texture = c.texture;
+		}
+
+		run.Push(c.x, c.y, c.angle, c.scaleX, c.scaleY, c.halfWidth, c.halfHeight,
+			c.u1, c.v1, c.u2, c.v2, c.color, zValues[index]);
+	}
+
+	DrawRun(texture);
+
+	batch->Flush();
+
+	if(depthMode)
+	{
+		//everything was opaque
+		if(opaquePass) opaqueCount += (int)commands.size();
+
+		//back to plain 2D state
+		glDepthMask(GL_TRUE);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+	}
+	batch->SetShader(previousShader);
+	batch->SetBlendFunc(previousSrc, previousDst);
+
+	commandCount += (int)commands.size();
+
+	keys.clear();
+	commands.clear();
+	zValues.clear();
+}
+
+void DrawQueue::DrawRun(GLuint texture)
+{
+	if(run.Size() == 0) return;
+
+	batch->AddSprites(texture, run.Arrays(), 0, run.Size());
+	run.Clear();
+}
+
+void DrawQueue::EndFrame(void)
+{
+	lastFrameCommandCount = commandCount;
+	lastFrameOpaqueCount = opaqueCount;
+	commandCount = opaqueCount = 0;
+}
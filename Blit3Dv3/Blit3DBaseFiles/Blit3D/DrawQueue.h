@@ -0,0 +1,106 @@
+#pragma once
+/*
+	Deferred, sorted draw queue for 2D mode.
+
+	When the queue is enabled (Blit3D::SetDrawQueue(true)), Sprite::Blit() and AngelcodeFont
+	text record a draw command instead of drawing. Every command carries a 64-bit sort key:
+
+	bits 56-63	layer		(Sprite::layer, 0 is drawn first)
+	bits 48-55	shader		(index into the queue's shader table, 0 is the built-in batch shader)
+	bits 40-47	blend mode	(B3D::BlendMode)
+	bits 16-39	texture id
+	bits 0-15	depth		(Sprite::depth, 1 = back, 0 = front; back is drawn first)
+
+	At Blit3D::Flush() the commands are radix-sorted on that key and fed to the SpriteBatch,
+	so within a layer everything on the same texture is drawn together no matter how the calls
+	were interleaved in Draw(). The sort is stable: commands with identical keys keep the order
+	they were submitted in.
+
+	Texture outranks depth in the key, so depth only orders sprites that share a texture (and
+	shader and blend mode). Sprites on different textures in the same layer can swap order no
+	matter their depths: put anything that must overlap in a specific way in different layers,
+	or turn on depth mode, whose blended pass sorts by depth first (see below).
+
+	Depth mode (Blit3D::SetDepthSorting2D(true)) cuts overdraw for fill-rate bound scenes.
+	Every quad gets a z from its layer and depth. Commands submitted with BlendMode::SOLID form an
+	opaque pass, drawn first, front to back, with depth writes on and blending off, so hidden
+	pixels are never shaded. Everything else is drawn afterwards, tested against the opaque pass
+	but without writing depth. In this mode the top bit of the key is the pass. The opaque pass
+	keeps the layout above, one bit lower (losing the lowest depth bit). The blended pass is
+	layer | depth | shader | blend | texture, so within a layer it is strictly back to front, even
+	across textures, at the cost of more texture switches. Only use SOLID for sprites with no
+	transparent pixels, and clear the depth buffer every frame.
+*/
+#include "Blit3D.h"
+#include <vector>
+#include <stdint.h>
+
+class Blit3D;
+class SpriteBatch;
+
+namespace B3D
+{
+	//blend modes the queue can sort on, see BlendModeFunc() for the glBlendFunc() values
+	enum class BlendMode { ALPHA = 0, ADDITIVE, MULTIPLY, PREMULTIPLIED, SOLID, COUNT };
+
+	//fills out the glBlendFunc() source and destination factors for a blend mode
+	void BlendModeFunc(BlendMode mode, GLenum &src, GLenum &dst);
+
+	//everything the SpriteBatch needs to draw one quad
+	class DrawCommand
+	{
+	public:
+		GLuint texture;
+		GLfloat halfWidth, halfHeight;
+		GLfloat u1, v1, u2, v2;
+		GLfloat x, y;
+		GLfloat angle; //in degrees
+		GLfloat scaleX, scaleY;
+		GLuint color; //RGBA tint, alpha included, see PackColor()
+	};
+}
+
+class DrawQueue
+{
+private:
+	std::vector<uint64_t> keys; //sort key of each command, in submission order
+	std::vector<B3D::DrawCommand> commands;
+	std::vector<GLfloat> zValues; //vertex z of each command, 0 unless in depth mode
+
+	//scratch space for the radix sort, kept around between frames
+	std::vector<uint64_t> sortKeys, sortKeysTemp;
+	std::vector<uint32_t> sortIndices, sortIndicesTemp;
+
+	std::vector<GLSLProgram *> shaders; //shader table, index 0 is NULL (built-in batch shader)
+	int currentShader;
+	B3D::BlendMode currentBlend;
+
+	SpriteBatch *batch; //where sorted commands end up
+	B3D::SpriteArrayBuffer run; //commands that share shader, blend and texture, gathered for the transform kernel
+
+	void DrawRun(GLuint texture);
+
+	void RadixSort(void); //sorts sortIndices by key, 8 bits per pass
+
+public:
+	bool active; //true when Sprite::Blit() should add to the queue instead of drawing
+	bool depthMode; //opaque pass with depth before the blended pass, set by Blit3D::SetDepthSorting2D()
+	int opaqueCount; //commands drawn in the opaque pass so far this frame
+	int lastFrameOpaqueCount; //total for the previous frame
+	int commandCount; //commands executed so far this frame
+	int lastFrameCommandCount; //total for the previous frame
+
+	DrawQueue(SpriteBatch *spriteBatch);
+
+	//records a quad, using the current shader and blend mode
+	void Submit(int layer, float depth, const B3D::DrawCommand &command);
+	void Flush(void); //sort everything queued and draw it through the SpriteBatch
+
+	//shader/blend mode for commands submitted from now on.
+	//The shader must take the same vertex layout as the built-in batch shader; NULL is the built-in one
+	void SetShader(GLSLProgram *shader);
+	void SetBlendMode(B3D::BlendMode mode);
+	B3D::BlendMode GetBlendMode(void) { return currentBlend; }
+
+	void EndFrame(void); //called by Blit3D once per frame to roll the stats over
+};
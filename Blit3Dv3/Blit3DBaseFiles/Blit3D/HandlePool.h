@@ -0,0 +1,190 @@
+#pragma once
+/*
+	Generational slot map.
+
+	Objects live in blocks of slots that never move, so creating one is a placement new into a
+	free slot and destroying one just puts the slot back on the free list: no heap allocation
+	or hashing once the pool has warmed up, and pointers stay valid until the object is
+	destroyed. Iterating with ForEach() walks the slots in memory order.
+
+	Every slot has a generation number that goes up each time its object is destroyed. A
+	Handle is a slot index plus the generation it was issued for, so a handle to a destroyed
+	object is detected as stale (Get() returns NULL) even after the slot has been reused.
+
+	Not thread-safe by itself: Blit3D guards each of its pools with a mutex.
+*/
+#include <vector>
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <cassert>
+
+namespace B3D
+{
+	template<class T>
+	class Handle
+	{
+	public:
+		uint32_t index;
+		uint32_t generation; //generations start at 1, so a default-constructed handle is always stale
+
+		Handle() : index(0), generation(0) {}
+		Handle(uint32_t slotIndex, uint32_t slotGeneration) : index(slotIndex), generation(slotGeneration) {}
+
+		bool operator==(const Handle &other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Handle &other) const { return !(*this == other); }
+	};
+
+	template<class T, uint32_t BLOCK_SLOTS = 256>
+	class HandlePool
+	{
+	private:
+		class Slot
+		{
+		public:
+			alignas(T) unsigned char storage[sizeof(T)]; //must stay the first member, see SlotOf()
+			uint32_t index;
+			uint32_t generation;
+			bool alive;
+		};
+
+		std::vector<Slot *> blocks; //BLOCK_SLOTS slots each
+		std::vector<uint32_t> freeSlots;
+		uint32_t slotCount; //slots ever used
+		size_t liveCount;
+
+		Slot &SlotAt(uint32_t index) { return blocks[index / BLOCK_SLOTS][index % BLOCK_SLOTS]; }
+
+		//the object is the first thing in its slot, so we get from one to the other for free
+		static Slot *SlotOf(T *object) { return reinterpret_cast<Slot *>(object); }
+
+		//the slot index of object, or false if it doesn't point at a slot in one of our blocks;
+		//only compares addresses, so it is safe for pointers that came from anywhere
+		bool IndexOf(T *object, uint32_t &index)
+		{
+			uintptr_t address = reinterpret_cast<uintptr_t>(object);
+			for(size_t b = 0; b < blocks.size(); ++b)
+			{
+				uintptr_t start = reinterpret_cast<uintptr_t>(blocks[b]);
+				if(address < start || address >= start + BLOCK_SLOTS * sizeof(Slot)) continue;
+				if((address - start) % sizeof(Slot) != 0) return false;
+
+				index = (uint32_t)(b * BLOCK_SLOTS + (address - start) / sizeof(Slot));
+				return index < slotCount;
+			}
+			return false;
+		}
+
+	public:
+		HandlePool() : slotCount(0), liveCount(0) {}
+
+		~HandlePool()
+		{
+			Clear();
+			for(Slot *block : blocks) delete[] block;
+		}
+
+		HandlePool(const HandlePool &) = delete;
+		HandlePool &operator=(const HandlePool &) = delete;
+
+		template<class... Args>
+		T *Create(Args&&... args)
+		{
+			uint32_t index;
+			if(!freeSlots.empty())
+			{
+				index = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else
+			{
+				if(slotCount % BLOCK_SLOTS == 0) blocks.push_back(new Slot[BLOCK_SLOTS]);
+				index = slotCount++;
+
+				Slot &fresh = SlotAt(index);
+				fresh.index = index;
+				fresh.generation = 1;
+				fresh.alive = false;
+			}
+
+			Slot &slot = SlotAt(index);
+			T *object = new(slot.storage) T(std::forward<Args>(args)...);
+			slot.alive = true;
+			liveCount++;
+
+			return object;
+		}
+
+		//true if object is alive in this pool
+		bool Contains(T *object)
+		{
+			uint32_t index;
+			if(object == NULL || !IndexOf(object, index)) return false;
+
+			return SlotAt(index).alive;
+		}
+
+		//returns false if the object isn't alive in this pool
+		bool Destroy(T *object)
+		{
+			if(!Contains(object)) return false;
+
+			Slot *slot = SlotOf(object);
+			object->~T();
+			slot->alive = false;
+			if(++slot->generation == 0) slot->generation = 1; //0 is reserved for default handles
+
+			freeSlots.push_back(slot->index);
+			liveCount--;
+			return true;
+		}
+
+		bool Destroy(Handle<T> handle)
+		{
+			T *object = Get(handle);
+			return object != NULL && Destroy(object);
+		}
+
+		//the object a handle refers to, or NULL if the handle is stale
+		T *Get(Handle<T> handle)
+		{
+			if(handle.index >= slotCount) return NULL;
+
+			Slot &slot = SlotAt(handle.index);
+			if(!slot.alive || slot.generation != handle.generation) return NULL;
+			return reinterpret_cast<T *>(slot.storage);
+		}
+
+		//a handle for a live object, or a stale handle if the object isn't in this pool
+		Handle<T> HandleOf(T *object)
+		{
+			if(!Contains(object)) return Handle<T>();
+
+			Slot *slot = SlotOf(object);
+			return Handle<T>(slot->index, slot->generation);
+		}
+
+		//calls func(T *) for every live object, in slot order
+		template<class Func>
+		void ForEach(Func func)
+		{
+			for(uint32_t i = 0; i < slotCount; ++i)
+			{
+				Slot &slot = SlotAt(i);
+				if(slot.alive) func(reinterpret_cast<T *>(slot.storage));
+			}
+		}
+
+		void Clear(void) //destroys every live object, keeps the memory
+		{
+			for(uint32_t i = 0; i < slotCount; ++i)
+			{
+				Slot &slot = SlotAt(i);
+				if(slot.alive) Destroy(reinterpret_cast<T *>(slot.storage));
+			}
+		}
+
+		size_t Size(void) { return liveCount; }
+	};
+}
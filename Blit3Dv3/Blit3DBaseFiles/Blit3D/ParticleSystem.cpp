@@ -0,0 +1,261 @@
+#include "ParticleSystem.h"
+#include <chrono>
+
+extern logger oLog;
+
+ParticleEmitter::ParticleEmitter(Blit3D *blit3d, std::string TextureFileName, int maxParticles)
+	: ParticleEmitter(blit3d, TextureFileName, 0.f, 0.f, 0.f, 0.f, maxParticles)
+{
+}
+
+ParticleEmitter::ParticleEmitter(Blit3D *blit3d, std::string TextureFileName, GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, int maxParticles)
+	: rng(std::random_device()()), unit(0.f, 1.f)
+{
+	assert(maxParticles > 0);
+
+	b3d = blit3d;
+	capacity = maxParticles;
+	count = 0;
+	spawnAccumulator = 0.0;
+
+	textureName = TextureFileName;
+	texHandle = b3d->tManager->Load(TextureFileName);
+	texId = b3d->tManager->TextureId(texHandle);
+	if(texId == 0)
+	{
+		oLog(Level::Severe) << "Image loading error while loading image file: " << TextureFileName << " for ParticleEmitter";
+		assert(texId != 0);
+	}
+
+	GLfloat textureWidth, textureHeight;
+	b3d->tManager->FetchDimensions(texHandle, textureWidth, textureHeight);
+
+	//a zero-sized rect means the whole texture
+	if(width <= 0.f || height <= 0.f)
+	{
+		startX = startY = 0.f;
+		width = textureWidth;
+		height = textureHeight;
+	}
+
+	//same UV convention as SpriteSheet::AddRegion()
+	halfWidth = width / 2.f;
+	halfHeight = height / 2.f;
+	u1 = startX / textureWidth;
+	u2 = (startX + width) / textureWidth;
+	v1 = 1.f - (startY / textureHeight);
+	v2 = 1.f - ((startY + height) / textureHeight);
+
+	//the pool never grows, so the arrays never move
+	std::vector<float> *fields[] = { &x, &y, &vx, &vy, &angle, &spin, &age, &invLife, &size, &r, &g, &b, &a };
+	for(std::vector<float> *field : fields) field->resize(capacity);
+
+	//some sensible defaults: a fountain of white particles fading out
+	position = glm::vec2(b3d->screenWidth / 2.f, b3d->screenHeight / 2.f);
+	area = glm::vec2(0.f, 0.f);
+	rate = 100.f;
+	emitting = true;
+	lifeMin = 1.f;
+	lifeMax = 2.f;
+	speedMin = 50.f;
+	speedMax = 150.f;
+	direction = 90.f;
+	spread = 30.f;
+	sizeMin = sizeMax = 1.f;
+	sizeEnd = 1.f;
+	spinMin = spinMax = 0.f;
+	gravity = glm::vec2(0.f, 0.f);
+	drag = 0.f;
+	colorStart = glm::vec4(1.f, 1.f, 1.f, 1.f);
+	colorEnd = glm::vec4(1.f, 1.f, 1.f, 0.f);
+}
+
+ParticleEmitter::~ParticleEmitter()
+{
+	b3d->tManager->FreeTexture(texHandle);
+}
+
+void ParticleEmitter::Spawn(int amount)
+{
+	amount = std::min(amount, capacity - count);
+
+	for(int n = 0; n < amount; ++n)
+	{
+		int i = count++;
+
+		float heading = glm::radians(direction + Random(-spread, spread));
+		float speed = Random(speedMin, speedMax);
+
+		x[i] = position.x + Random(-area.x, area.x);
+		y[i] = position.y + Random(-area.y, area.y);
+		vx[i] = cosf(heading) * speed;
+		vy[i] = sinf(heading) * speed;
+		angle[i] = Random(0.f, 360.f);
+		spin[i] = Random(spinMin, spinMax);
+		age[i] = 0.f;
+		invLife[i] = 1.f / std::max(Random(lifeMin, lifeMax), 0.001f);
+		size[i] = Random(sizeMin, sizeMax);
+		r[i] = colorStart.r;
+		g[i] = colorStart.g;
+		b[i] = colorStart.b;
+		a[i] = colorStart.a;
+	}
+}
+
+void ParticleEmitter::Kill(int index)
+{
+	//move the last live particle into the hole
+	int last = --count;
+
+	x[index] = x[last];
+	y[index] = y[last];
+	vx[index] = vx[last];
+	vy[index] = vy[last];
+	angle[index] = angle[last];
+	spin[index] = spin[last];
+	age[index] = age[last];
+	invLife[index] = invLife[last];
+	size[index] = size[last];
+	r[index] = r[last];
+	g[index] = g[last];
+	b[index] = b[last];
+	a[index] = a[last];
+}
+
+void ParticleEmitter::Burst(int amount)
+{
+	Spawn(amount);
+}
+
+void ParticleEmitter::Clear(void)
+{
+	count = 0;
+	spawnAccumulator = 0.0;
+}
+
+void ParticleEmitter::Update(double seconds)
+{
+	float dt = (float)seconds;
+	float damping = std::max(0.f, 1.f - drag * dt);
+	float gx = gravity.x * dt;
+	float gy = gravity.y * dt;
+
+	//raw pointers and no branches, so each loop vectorizes
+	float *px = x.data(), *py = y.data(), *pvx = vx.data(), *pvy = vy.data();
+	float *pangle = angle.data(), *pspin = spin.data(), *page = age.data();
+	int n = count;
+
+	for(int i = 0; i < n; ++i)
+	{
+		pvx[i] = (pvx[i] + gx) * damping;
+		pvy[i] = (pvy[i] + gy) * damping;
+		px[i] += pvx[i] * dt;
+		py[i] += pvy[i] * dt;
+		pangle[i] += pspin[i] * dt;
+		page[i] += dt;
+	}
+
+	//blend the colors over each particle's life
+	const float *pinv = invLife.data();
+	float *pr = r.data(), *pg = g.data(), *pb = b.data(), *pa = a.data();
+	glm::vec4 change = colorEnd - colorStart;
+
+	for(int i = 0; i < n; ++i)
+	{
+		float t = std::min(page[i] * pinv[i], 1.f);
+		pr[i] = colorStart.r + change.r * t;
+		pg[i] = colorStart.g + change.g * t;
+		pb[i] = colorStart.b + change.b * t;
+		pa[i] = colorStart.a + change.a * t;
+	}
+
+	//swap-remove the dead; the particle moved into the hole still needs checking, so don't advance
+	for(int i = 0; i < count;)
+	{
+		if(age[i] * invLife[i] >= 1.f) Kill(i);
+		else ++i;
+	}
+
+	if(emitting)
+	{
+		spawnAccumulator += seconds * rate;
+		int amount = (int)spawnAccumulator;
+		spawnAccumulator -= amount;
+		Spawn(amount);
+	}
+}
+
+void ParticleEmitter::Draw(void)
+{
+	if(count == 0) return;
+
+	B3D::SpriteInstance *instances = b3d->spriteInstancer->AddInstances(texId, count);
+
+	float sizeChange = sizeEnd - 1.f;
+
+	for(int i = 0; i < count; ++i)
+	{
+		float t = std::min(age[i] * invLife[i], 1.f);
+		float scale = size[i] * (1.f + sizeChange * t);
+
+		B3D::SpriteInstance &instance = instances[i];
+		instance.x = x[i];
+		instance.y = y[i];
+		instance.angle = glm::radians(angle[i]);
+		instance.color = B3D::PackColor(r[i], g[i], b[i], a[i]);
+		instance.halfWidth = halfWidth * scale;
+		instance.halfHeight = halfHeight * scale;
+		instance.u1 = u1;
+		instance.v1 = v1;
+		instance.u2 = u2;
+		instance.v2 = v2;
+	}
+}
+
+void B3D::BenchmarkParticles(Blit3D *blit3d, std::string TextureFileName)
+{
+	const int sizes[] = { 10000, 100000, 1000000 };
+	const int frames = 10; //best of, to keep other processes out of the numbers
+	const double frameTime = 1.0 / 60.0;
+
+	oLog(Level::Info) << "Particle benchmark";
+
+	for(int particles : sizes)
+	{
+		ParticleEmitter *emitter = blit3d->MakeParticleEmitter(TextureFileName, particles);
+		emitter->emitting = false;
+		emitter->lifeMin = emitter->lifeMax = 1000.f; //nobody dies, so every frame has the full count
+		emitter->speedMin = 10.f;
+		emitter->speedMax = 100.f;
+		emitter->spread = 180.f;
+		emitter->gravity = glm::vec2(0.f, -50.f);
+		emitter->drag = 0.1f;
+		emitter->Burst(particles);
+
+		//whatever was queued before us shouldn't be in our numbers
+		blit3d->Flush();
+		glFinish();
+
+		double updateTime = 1e30;
+		double renderTime = 1e30;
+		for(int f = 0; f < frames; ++f)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			emitter->Update(frameTime);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if(elapsed.count() < updateTime) updateTime = elapsed.count();
+
+			start = std::chrono::high_resolution_clock::now();
+			emitter->Draw();
+			blit3d->Flush();
+			glFinish();
+			elapsed = std::chrono::high_resolution_clock::now() - start;
+			if(elapsed.count() < renderTime) renderTime = elapsed.count();
+		}
+
+		oLog(Level::Info) << emitter->Count() << " particles, update: " << updateTime << " ms (" << emitter->Count() / updateTime
+			<< " particles/ms), render: " << renderTime << " ms (" << emitter->Count() / renderTime << " particles/ms)";
+
+		blit3d->DeleteParticleEmitter(emitter);
+	}
+}
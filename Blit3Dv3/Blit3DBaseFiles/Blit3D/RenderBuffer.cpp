@@ -27,7 +27,7 @@ RenderBuffer::RenderBuffer(int width, int height, TextureManager *TexManager, st
 		GL_TEXTURE_2D, color_tex, 0);
 
 	//ad the texture to the TM
-	texManager->AddLoadedTexture(name, color_tex);
+	texHandle = texManager->AddLoadedTexture(name, color_tex);
 
 	// create a render buffer as our depth buffer and attach it
 	glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
@@ -53,14 +53,14 @@ RenderBuffer::~RenderBuffer()
 	b3d->DeleteSprite(sprite);
 	glDeleteFramebuffers(1, &fb);
 	glDeleteRenderbuffers(1, &depth_rb);
-	//the next line will bomb if the TM has already been freed,
-	//so be sure to delete all RenderBuffers *before* deleting
-	//the TM, just like Sprites
-	texManager->FreeTexture(texname);
+	//the next line will bomb if the TM has already been freed;
+	//Blit3D clears its RenderBuffer pool before deleting the TM
+	texManager->FreeTexture(texHandle);
 }
 
 void RenderBuffer::RenderToMe(GLSLProgram *shader)
 {
+	b3d->Flush(); //batched sprites belong in the previous render target
 	glBindFramebuffer(GL_FRAMEBUFFER, fb);
 	b3d->ReshapFBO(texwidth, texheight, shader);
 	//save shader program for when we are done and need to reset the perspective matrix
@@ -69,6 +69,7 @@ void RenderBuffer::RenderToMe(GLSLProgram *shader)
 
 void RenderBuffer::RenderToMe()
 {
+	b3d->Flush(); //batched sprites belong in the previous render target
 	glBindFramebuffer(GL_FRAMEBUFFER, fb);
 	b3d->ReshapFBO(texwidth, texheight, b3d->shader2d);
 	//save shader program for when we are done and need to reset the perspective matrix
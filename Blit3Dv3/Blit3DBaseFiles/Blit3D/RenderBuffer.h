@@ -1,14 +1,22 @@
 #pragma once
 #include "Blit3D.h"
+#include "HandlePool.h"
 
 class Blit3D;
 class Sprite;
 
 class RenderBuffer
 {
+private:
+	//RenderBuffers live in Blit3D's pool, so only the pool may destroy them. This used to be public and
+	//callers freed Blit3D::MakeRenderBuffer()'s result with delete; call Blit3D::DeleteRenderBuffer() instead
+	friend class B3D::HandlePool<RenderBuffer>;
+	~RenderBuffer();
+
 public:
 	GLuint fb;//FBO
 	GLuint color_tex; //texture ID
+	TextureHandle texHandle; //color_tex in the TM
 	GLuint depth_rb;//depth buffer
 	TextureManager *texManager;
 	std::string texname;
@@ -19,7 +27,6 @@ public:
 	Sprite *sprite; //so we can draw with this render buffer
 
 	RenderBuffer(int width, int height, TextureManager *TexManager, std::string name, Blit3D *blit3d);
-	~RenderBuffer();
 	void RenderToMe(GLSLProgram *shader);
 	void RenderToMe();
 	void DoneRendering();
@@ -1,16 +1,60 @@
 #include "ShaderManager.h"
 #include "Logger.h"
 #include <cassert>
+#include <cstring>
 
 //use the main Blit3D logger
 extern logger oLog;
 
+ShaderManager::ShaderManager()
+{
+	static_assert(sizeof(FrameUniforms) == 144, "FrameUniforms must match the std140 layout of FRAME_UNIFORMS_GLSL");
+
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameUBO);
+
+	frameDataValid = false;
+	frameUploads = 0;
+}
+
 ShaderManager::~ShaderManager()
 {
 	for (auto item : ShaderMap)
 	{
 		delete item.second;
 	}
+
+	glDeleteBuffers(1, &frameUBO);
+}
+
+void ShaderManager::BindFrameUniforms(GLSLProgram *prog)
+{
+	GLuint handle = (GLuint)prog->getHandle();
+	GLuint blockIndex = glGetUniformBlockIndex(handle, FRAME_UNIFORM_BLOCK);
+	if (blockIndex != GL_INVALID_INDEX) glUniformBlockBinding(handle, blockIndex, FRAME_UNIFORM_BINDING);
+}
+
+void ShaderManager::SetFrameUniforms(const glm::mat4 &projection, const glm::mat4 &view, glm::vec2 screenSize, float time)
+{
+	FrameUniforms data;
+	data.projectionMatrix = projection;
+	data.viewMatrix = view;
+	data.screenSize = screenSize;
+	data.time = time;
+	data.padding = 0.f;
+
+	if (frameDataValid && memcmp(&data, &frameData, sizeof(FrameUniforms)) == 0) return;
+
+	frameData = data;
+	frameDataValid = true;
+	frameUploads++;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frameData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 GLSLProgram* ShaderManager::Load(const char* vertName, const char*fragName)
@@ -41,6 +85,8 @@ GLSLProgram* ShaderManager::Load(const char* vertName, const char*fragName)
 		return NULL;
 	}
 
+	BindFrameUniforms(prog);
+
 	assert(prog != NULL);
 	return prog;
 }
@@ -73,6 +119,8 @@ GLSLProgram* ShaderManager::LoadFromStrings(const char* vertName, const char*fra
 		return NULL;
 	}
 
+	BindFrameUniforms(prog);
+
 	assert(prog != NULL);
 	return prog;
 }
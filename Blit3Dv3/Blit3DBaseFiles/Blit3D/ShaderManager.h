@@ -3,6 +3,7 @@
 	TODO:	make ShaderManager store individual compiled shaders and look them up when linking,
 			so that progs can re-use vert or frag shaders without recompiling?
 
+	Version 1.2 - owns the per-frame uniform block (see below) and binds it in every program it links
 	Version 1.1
 */
 
@@ -10,6 +11,35 @@
 
 #include "glslprogram.h"
 
+/*
+	Per-frame uniform block: the camera and frame data every shader needs, kept in one uniform
+	buffer at a fixed binding point instead of being sent to each program separately.
+	Blit3D refreshes it when the matrices or the render target change, and once a frame for the time.
+	To use it in your own shaders, put FRAME_UNIFORMS_GLSL after the #version line; the members are then
+	visible as plain names (projectionMatrix, viewMatrix, screenSize, time). ShaderManager binds the
+	block for you, shaders not loaded through it can call ShaderManager::BindFrameUniforms().
+*/
+#define FRAME_UNIFORM_BINDING 0
+#define FRAME_UNIFORM_BLOCK "FrameData"
+#define FRAME_UNIFORMS_GLSL "layout(std140) uniform FrameData \n" \
+	"{ \n" \
+		"mat4 projectionMatrix; \n" \
+		"mat4 viewMatrix; \n" \
+		"vec2 screenSize; \n" \
+		"float time; \n" \
+	"}; \n"
+
+//CPU copy of the block, laid out to match std140
+class FrameUniforms
+{
+public:
+	glm::mat4 projectionMatrix;
+	glm::mat4 viewMatrix;
+	glm::vec2 screenSize; //of the current render target, in pixels
+	float time; //seconds since Blit3D started
+	float padding; //std140 rounds the block up to a multiple of 16 bytes
+};
+
 class ShaderManager
 {
 private:
@@ -20,7 +50,20 @@ private:
 
 	std::map<std::string, GLSLProgram*>::iterator shaderIter;
 
+	GLuint frameUBO;
+	FrameUniforms frameData; //what frameUBO holds
+	bool frameDataValid; //false until the first upload
+
 public:
+	unsigned long long frameUploads; //times the frame block actually changed and was sent
+
+	//makes the frame uniform buffer, needs a GL context
+	ShaderManager();
+	//points the program's FrameData block, if it has one, at FRAME_UNIFORM_BINDING
+	static void BindFrameUniforms(GLSLProgram *prog);
+	//sends the frame block if anything in it changed since the last call
+	void SetFrameUniforms(const glm::mat4 &projection, const glm::mat4 &view, glm::vec2 screenSize, float time);
+
 	//Try to retrive a shader: if none exists for this combination or vert and frag shaders, load and 
 	//compile and link it, then store on map
 	GLSLProgram* GetShader(const char* vertName, const char* fragName);
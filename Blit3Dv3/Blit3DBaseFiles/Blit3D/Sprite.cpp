@@ -3,208 +3,101 @@
 extern logger oLog;
 
 //textured Sprite class --------------------------------------------------------------
-Sprite::Sprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height,
-	std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader)
+Sprite::Sprite(SpriteSheet *spriteSheet, int regionIndex, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d)
 {
 	dest_x = 0.f;
 	dest_y = 0.f;
 	angle = 0.f;
 	alpha = 1.f;
+	color = glm::vec4(1.f);
 	scale_x = scale_y = 1.f;
-
-	GLfloat halfSizeX, halfSizeY;//x,y half-dimensions of the quad
-
-	halfSizeX = width / 2.f;
-	halfSizeY = height / 2.f;
+	layer = 0;
+	depth = 0.f;
 
 	prog = shader;
-
-	GLfloat imagewidth, imageheight;
-	textureName = TextureFileName;
+	b3d = blit3d;
 	texManager = TexManager;
 
-	//load the texture via the texture manager
-	texId = texManager->LoadTexture(TextureFileName);
-	if(texId == 0)
-	{
-		oLog(Level::Severe) << "Image loading error while loading image file: " << TextureFileName << "for Sprite";
-		assert(texId != 0);
-	}
-
-	texManager->FetchDimensions(TextureFileName, imagewidth, imageheight);
-
-	GLfloat u1 = startX / imagewidth;
-	GLfloat u2 = (startX + width) / imagewidth;
-
-	GLfloat v1 = 1.f - (startY / imageheight);
-	GLfloat v2 = 1.f - ((startY + height) / imageheight);
-
-
-	verts = new B3D::TVertex[4]; //make an array of Textured Vertices
-
-	// generate a new VAO and get the associated ID
-	glGenVertexArrays(1, &vaoId); // Create our Vertex Array Object  
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object so we can use it  
-
-	// generate a new VBO and get the associated ID
-	glGenBuffers(1, &vboId);
-
-	// bind VBO in order to use
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-
-	//set the vertex array points...we need 4 vertices, one for each corner of our sprite, 
-
-	/*
-
-	0-------2
-	|       |
-	|       |
-	|       |
-	1-------3
-	*/
-
-	//front side, counterclockwise
-	//point 0
-	verts[0].x = -halfSizeX;				verts[0].y = halfSizeY;			verts[0].z = 0.f;
-	verts[0].u = u1;	verts[0].v = v1;
-	//point 1
-	verts[1].x = -halfSizeX;				verts[1].y = -halfSizeY;		verts[1].z = 0.f;
-	verts[1].u = u1;	verts[1].v = v2;
-	//point 2
-	verts[2].x = halfSizeX;					verts[2].y = halfSizeY;			verts[2].z = 0.f;
-	verts[2].u = u2;	verts[2].v = v1;
-	//point 3
-	verts[3].x = halfSizeX;					verts[3].y = -halfSizeY;		verts[3].z = 0.f;
-	verts[3].u = u2;	verts[3].v = v2;
-	
-
-	// upload data to VBO
-	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4, verts, GL_STATIC_DRAW);
-
-	// Set up our vertex attributes pointers
-	///we don't really need normals for 2D, except maybe for special effects.
-	//We send them anyway, as we don't have special shaders for 2d mode (YET!)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 	
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(sizeof(GLfloat)* 3)); //Start after x,y,z data 
-
-
-	// activate attribute array
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glDisableVertexAttribArray(2); //don't use channel 2
-	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
-
-
-	glBindVertexArray(0); // Disable our Vertex Array Object? 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
-
-	//free the memory once it's been uploaded
-	delete[] verts;
+	//the sheet owns the texture and the geometry, we just remember which rect is ours
+	sheet = spriteSheet;
+	region = regionIndex;
+	texId = sheet->texId;
 }
 
-Sprite::Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader)
+void Sprite::SetRegion(int regionIndex)
 {
-	dest_x = 0.f;
-	dest_y = 0.f;
-	angle = 0.f;
-	alpha = 1.f;
-	scale_x = scale_y = 1.f;
-
-	GLfloat halfSizeX, halfSizeY;//x,y half-dimensions of the quad
-
-	halfSizeX = rb->texwidth / 2.f;
-	halfSizeY = rb->texheight / 2.f;
-
-	prog = shader;
-
-	GLfloat u1 = 0.f;
-	GLfloat u2 = 1.f;
-
-	GLfloat v1 = 1.f;
-	GLfloat v2 = 0.f;
-
-	textureName = rb->texname;
-	texManager = TexManager;
-
-	//get the texture from the renderBuffer
-	texId = rb->color_tex;
-
-	//increment our use of this texture
-	texManager->AddLoadedTexture(textureName, texId);
-
-	verts = new B3D::TVertex[4]; //make an array of Textured Vertices
-
-	// generate a new VAO and get the associated ID
-	glGenVertexArrays(1, &vaoId); // Create our Vertex Array Object  
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object so we can use it  
-
-	// generate a new VBO and get the associated ID
-	glGenBuffers(1, &vboId);
-
-	// bind VBO in order to use
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-
-	//set the vertex array points...we need 4 vertices, one for each corner of our sprite, 
-
-	/*
-
-	0-------2
-	|       |
-	|       |
-	|       |
-	1-------3
-	*/
-
-	//front side, counterclockwise
-	//point 0
-	verts[0].x = -halfSizeX;				verts[0].y = halfSizeY;			verts[0].z = 0.f;
-	verts[0].u = u1;	verts[0].v = v1;
-	//point 1
-	verts[1].x = -halfSizeX;				verts[1].y = -halfSizeY;		verts[1].z = 0.f;
-	verts[1].u = u1;	verts[1].v = v2;
-	//point 2
-	verts[2].x = halfSizeX;					verts[2].y = halfSizeY;			verts[2].z = 0.f;
-	verts[2].u = u2;	verts[2].v = v1;
-	//point 3
-	verts[3].x = halfSizeX;					verts[3].y = -halfSizeY;		verts[3].z = 0.f;
-	verts[3].u = u2;	verts[3].v = v2;
-
-	// upload data to VBO
-	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4, verts, GL_STATIC_DRAW);
-
-	// Set up our vertex attributes pointers
-	///we don't really need normals for 2D, except maybe for special effects.
-	//We send them anyway, as we don't have special shaders for 2d mode (YET!)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 	
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(sizeof(GLfloat)* 3)); //Start after x,y,z data 
-
-
-	// activate attribute array
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glDisableVertexAttribArray(2); //don't use channel 2
-	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
-
-	glBindVertexArray(0); // Disable our Vertex Array Object? 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
+	assert(regionIndex >= 0 && regionIndex < (int)sheet->regions.size() && "Sprite::SetRegion(): no such region in the sheet");
+	region = regionIndex;
+}
 
-	//free the memory once it's been uploaded
-	delete[] verts;
+bool Sprite::OnScreen(void)
+{
+	//bounding circle of the scaled sprite, good for any angle
+	B3D::SpriteRegion &r = sheet->regions[region];
+	float x = dest_x, y = dest_y, a = angle, sx = scale_x, sy = scale_y;
+	r.Place(x, y, a, sx, sy);
+	float hx = r.halfWidth * sx;
+	float hy = r.halfHeight * sy;
+
+	return b3d->camera2d->IsVisible(x, y, sqrtf(hx * hx + hy * hy));
 }
 
 Sprite::~Sprite()
 {
-	// free texture
-	texManager->FreeTexture(textureName);
-
-	// delete VBO when object destroyed
-	glDeleteBuffers(1, &vboId);
-	glDeleteVertexArrays(1, &vaoId);
+	//nothing to free: Blit3D releases our SpriteSheet when it deletes us
 }
 
 void Sprite::Blit(void)
 {
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
+	if(!OnScreen())
+	{
+		//reset scaling and alpha
+		alpha = scale_x = scale_y = 1.f;
+		return;
+	}
+
+	if(b3d->drawQueue->active)
+	{
+		//record a command, the queue sorts it by layer, state and texture at the next flush
+		B3D::SpriteRegion &r = sheet->regions[region];
+		B3D::DrawCommand command;
+		command.texture = texId;
+		command.halfWidth = r.halfWidth;
+		command.halfHeight = r.halfHeight;
+		command.u1 = r.u1;
+		command.v1 = r.v1;
+		command.u2 = r.u2;
+		command.v2 = r.v2;
+		command.x = dest_x;
+		command.y = dest_y;
+		command.angle = angle;
+		command.scaleX = scale_x;
+		command.scaleY = scale_y;
+		r.Place(command.x, command.y, command.angle, command.scaleX, command.scaleY);
+		command.color = B3D::PackColor(color.r, color.g, color.b, color.a * alpha);
+
+		b3d->drawQueue->Submit(layer, depth, command);
+
+		//reset scaling and alpha
+		alpha = scale_x = scale_y = 1.f;
+		return;
+	}
+
+	if(b3d->spriteBatch->active)
+	{
+		//let the batch transform and draw us later, along with every other sprite on this texture
+		B3D::SpriteRegion &r = sheet->regions[region];
+		float x = dest_x, y = dest_y, a = angle, sx = scale_x, sy = scale_y;
+		r.Place(x, y, a, sx, sy);
+		b3d->spriteBatch->AddSprite(texId, r.halfWidth, r.halfHeight, r.u1, r.v1, r.u2, r.v2,
+			x, y, a, sx, sy, B3D::PackColor(color.r, color.g, color.b, color.a * alpha));
+
+		//reset scaling and alpha
+		alpha = scale_x = scale_y = 1.f;
+		return;
+	}
+
+	sheet->Bind(); // Bind the shared Vertex Array Object of our sheet
 
 	//bind our texture
 	texManager->BindTexture(texId);
@@ -226,8 +119,14 @@ void Sprite::Blit(void)
 	prog->setUniform("in_Scale_X", scale_x);
 	prog->setUniform("in_Scale_Y", scale_y);
 
-	// draw a triangle strip
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	//the Color channel is disabled in the sheet's VAO, so the tint comes from the attribute's current value
+	bool tinted = color != glm::vec4(1.f);
+	if(tinted) glVertexAttrib4f(3, color.r, color.g, color.b, color.a);
+
+	// draw a triangle strip, our region's 4 verts
+	glDrawArrays(GL_TRIANGLE_STRIP, region * 4, 4);
+
+	if(tinted) glVertexAttrib4f(3, 1.f, 1.f, 1.f, 1.f);
 
 	// bind with 0, so, switch back to normal pointer operation
 	glBindVertexArray(0);
@@ -270,4 +169,93 @@ void Sprite::Blit(float x, float y, float scale_val_x, float scale_val_y, float
 	dest_y = y;
 
 	Blit();
-}
\ No newline at end of file
+}
+
+void Sprite::BlitInstanced(void)
+{
+	if(!OnScreen())
+	{
+		//reset scaling and alpha
+		alpha = scale_x = scale_y = 1.f;
+		return;
+	}
+
+	B3D::SpriteRegion &r = sheet->regions[region];
+	float x = dest_x, y = dest_y, a = angle, sx = scale_x, sy = scale_y;
+	r.Place(x, y, a, sx, sy);
+
+	B3D::SpriteInstance instance;
+	instance.x = x;
+	instance.y = y;
+	instance.angle = glm::radians(a);
+	instance.color = B3D::PackColor(color.r, color.g, color.b, color.a * alpha);
+	instance.halfWidth = r.halfWidth * sx;
+	instance.halfHeight = r.halfHeight * sy;
+	instance.u1 = r.u1;
+	instance.v1 = r.v1;
+	instance.u2 = r.u2;
+	instance.v2 = r.v2;
+
+	b3d->spriteInstancer->AddInstance(texId, instance);
+
+	//reset scaling and alpha
+	alpha = scale_x = scale_y = 1.f;
+}
+
+void Sprite::BlitInstanced(float x, float y)
+{
+	dest_x = x;
+	dest_y = y;
+
+	BlitInstanced();
+}
+
+void Sprite::BlitInstanced(float alpha_val)
+{
+	alpha = alpha_val;
+	BlitInstanced();
+}
+
+void Sprite::BlitInstanced(float x, float y, float scale_val_x, float scale_val_y)
+{
+	scale_x = scale_val_x;
+	scale_y = scale_val_y;
+	dest_x = x;
+	dest_y = y;
+
+	BlitInstanced();
+}
+
+void Sprite::BlitInstanced(float x, float y, float scale_val_x, float scale_val_y, float alpha_val)
+{
+	scale_x = scale_val_x;
+	scale_y = scale_val_y;
+	alpha = alpha_val;
+	dest_x = x;
+	dest_y = y;
+
+	BlitInstanced();
+}
+void Sprite::BlitToSegment(SpriteBatchSegment *segment, float x, float y) const
+{
+	BlitToSegment(segment, x, y, 0.f, 1.f, 1.f, 1.f);
+}
+
+void Sprite::BlitToSegment(SpriteBatchSegment *segment, float x, float y, float angle_val, float scale_val_x, float scale_val_y, float alpha_val) const
+{
+	const B3D::SpriteRegion &r = sheet->regions[region];
+	r.Place(x, y, angle_val, scale_val_x, scale_val_y);
+
+	float hx = r.halfWidth * scale_val_x;
+	float hy = r.halfHeight * scale_val_y;
+	//count in the segment, not the camera, so the workers don't all fight over one counter
+	if(!b3d->camera2d->IsVisibleNoUpdate(x, y, sqrtf(hx * hx + hy * hy)))
+	{
+		segment->culledCount++;
+		return;
+	}
+	segment->visibleCount++;
+
+	segment->AddSprite(texId, r.halfWidth, r.halfHeight, r.u1, r.v1, r.u2, r.v2,
+		x, y, angle_val, scale_val_x, scale_val_y, B3D::PackColor(color.r, color.g, color.b, color.a * alpha_val));
+}
@@ -3,6 +3,8 @@
 
 class Blit3D;
 class RenderBuffer;
+class SpriteSheet;
+class SpriteBatchSegment;
 
 namespace B3D
 {
@@ -13,34 +15,53 @@ namespace B3D
 class Sprite
 {
 private:
-	B3D::TVertex *verts;  // memory for vertice data
-	GLuint vboId;	// ID of VBO
-	GLuint vaoId;	//ID of the VAO 		
+	SpriteSheet *sheet; //shared geometry and texture for every sprite cut from the same image
+	int region; //which rect of the sheet we draw
 
 	GLuint texId; //ID of texture
-	std::string textureName; //filename of the texture
 	TextureManager *texManager; //pointer to the global texture manager
-	glm::mat4 modelMatrix; // Store the model matrix 
+	glm::mat4 modelMatrix; // Store the model matrix
 	int modelMatrixLocation; // Store the location of our model matrix in the shader
 	int alphaLocation; //store the location of the alpha variable in the shader
 
 	GLSLProgram *prog; //shader program for 2D
+	Blit3D *b3d;
+
+	bool OnScreen(void); //asks the Camera2D, counts as culled/visible
 
 public:
 	GLfloat dest_x; //window coordinates of the center of the sprite, in pixels
 	GLfloat dest_y;
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha; //amount of extra alpha-blending to apply, modifies opacity of the sprite
+	glm::vec4 color; //tint multiplied with the texels, white by default; unlike alpha it is not reset after a Blit()
 	GLfloat scale_x, scale_y; //scaling value, 1 = 100%, 0.5 = half size, etc.
+	int layer; //draw queue layer, 0-255, lower layers are drawn first
+	float depth; //draw queue depth within a layer, 0 = front, 1 = back
 	void Blit(void); //draw the sprite
 	void Blit(float x, float y); //draw the sprite centered at x,y
 	void Blit(float alpha_val); //draw the sprite with set alpha
 	void Blit(float x, float y, float scale_val_x, float scale_val_y); //draw the sprite centered at x,y with set scale
 	void Blit(float x, float y, float scale_val_x, float scale_val_y, float alpha_val); //draw the sprite centered at x,y with set scale and alpha
 
+	//same as the Blit() calls, but the sprite is drawn later by the SpriteInstancer,
+	//with every other instanced sprite on the same texture
+	void BlitInstanced(void);
+	void BlitInstanced(float x, float y);
+	void BlitInstanced(float alpha_val);
+	void BlitInstanced(float x, float y, float scale_val_x, float scale_val_y);
+	void BlitInstanced(float x, float y, float scale_val_x, float scale_val_y, float alpha_val);
+
+	//adds the sprite to a SpriteBatchSegment, without touching dest_x, angle etc.,
+	//so worker threads can share sprites; see Blit3D::SubmitBatchSegment()
+	void BlitToSegment(SpriteBatchSegment *segment, float x, float y) const;
+	void BlitToSegment(SpriteBatchSegment *segment, float x, float y, float angle_val, float scale_val_x, float scale_val_y, float alpha_val) const;
+
+	SpriteSheet *GetSheet(void) { return sheet; }
+	int GetRegion(void) { return region; }
+	void SetRegion(int regionIndex); //show another rect of the same sheet, e.g. the next animation frame
+
 	//we won't call this constructor directly, we'll let the Blit3D object do that
-	Sprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height,
-		std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader);
-	Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader);
+	Sprite(SpriteSheet *spriteSheet, int regionIndex, TextureManager *TexManager, GLSLProgram *shader, Blit3D *blit3d);
 	~Sprite();
 };
@@ -0,0 +1,323 @@
+#include "SpriteBatch.h"
+
+extern logger oLog;
+
+SpriteBatch::SpriteBatch(Blit3D *blit3d, GLSLProgram *shader, StreamBuffer *streamBuffer)
+{
+	b3d = blit3d;
+	prog = shader;
+	stream = streamBuffer;
+	active = false;
+	texId = 0;
+
+	verts = NULL;
+	streamOffset = 0;
+	quads = maxQuads = 0;
+
+	//Blit3D::Run() starts us off with standard alpha blending
+	blendSrc = GL_SRC_ALPHA;
+	blendDst = GL_ONE_MINUS_SRC_ALPHA;
+
+	drawCalls = quadCount = 0;
+	lastFrameDrawCalls = lastFrameQuadCount = 0;
+
+	//the index buffer never changes: two triangles per quad, matching the sprite corner order
+	/*
+	0-------2
+	|       |
+	|       |
+	|       |
+	1-------3
+	*/
+	GLuint *indices = new GLuint[SPRITEBATCH_MAX_QUADS * 6];
+	for(GLuint i = 0; i < SPRITEBATCH_MAX_QUADS; ++i)
+	{
+		indices[i * 6] = i * 4;
+		indices[i * 6 + 1] = i * 4 + 1;
+		indices[i * 6 + 2] = i * 4 + 2;
+		indices[i * 6 + 3] = i * 4 + 2;
+		indices[i * 6 + 4] = i * 4 + 1;
+		indices[i * 6 + 5] = i * 4 + 3;
+	}
+
+	// generate a new VAO and get the associated ID
+	glGenVertexArrays(1, &vaoId);
+	glBindVertexArray(vaoId);
+
+	glGenBuffers(1, &iboId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * SPRITEBATCH_MAX_QUADS * 6, indices, GL_STATIC_DRAW);
+
+	//vertices come from the stream buffer, each draw call picks its spot with a base vertex
+	glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(0)); //x,y,z
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 5)); //color
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2); //don't use channel 2
+	glEnableVertexAttribArray(3); //Color channel carries the tint
+
+	//unbind the VAO first, so it keeps its element buffer binding
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	delete[] indices;
+
+	oLog(Level::Info) << "Created SpriteBatch with room for " << SPRITEBATCH_MAX_QUADS << " sprites per draw call";
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	glDeleteBuffers(1, &iboId);
+	glDeleteVertexArrays(1, &vaoId);
+}
+
+void SpriteBatch::AddSprite(GLuint texture, GLfloat halfWidth, GLfloat halfHeight,
+	GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2,
+	GLfloat x, GLfloat y, GLfloat angle, GLfloat scaleX, GLfloat scaleY, GLuint color)
+{
+	//a texture change means a new draw call
+	if(texture != texId)
+	{
+		Flush();
+		texId = texture;
+	}
+	else if(quads == maxQuads) Flush();
+
+	if(verts == NULL)
+	{
+		//grab as much of the stream as we may need, at least one sprite's worth
+		GLsizeiptr reservedBytes = 0;
+		verts = (B3D::BVertex *)stream->Reserve(sizeof(B3D::BVertex) * 4, sizeof(B3D::BVertex) * 4 * SPRITEBATCH_MAX_QUADS,
+			sizeof(B3D::BVertex), streamOffset, reservedBytes);
+		maxQuads = (int)(reservedBytes / (sizeof(B3D::BVertex) * 4));
+		quads = 0;
+	}
+
+	//same transform the shader used to do: scale, then rotate, then translate
+	float radians = glm::radians(angle);
+	float c = cosf(radians);
+	float s = sinf(radians);
+
+	float hx = halfWidth * scaleX;
+	float hy = halfHeight * scaleY;
+
+	//rotated half-extent vectors
+	float ax = hx * c, ay = hx * s;
+	float bx = -hy * s, by = hy * c;
+
+	//write straight into the mapped buffer
+	B3D::BVertex *quad = &verts[quads * 4];
+
+	//point 0, top left
+	quad[0].x = x - ax + bx;	quad[0].y = y - ay + by;	quad[0].z = 0.f;
+	quad[0].u = u1;	quad[0].v = v1;	quad[0].color = color;
+	//point 1, bottom left
+	quad[1].x = x - ax - bx;	quad[1].y = y - ay - by;	quad[1].z = 0.f;
+	quad[1].u = u1;	quad[1].v = v2;	quad[1].color = color;
+	//point 2, top right
+	quad[2].x = x + ax + bx;	quad[2].y = y + ay + by;	quad[2].z = 0.f;
+	quad[2].u = u2;	quad[2].v = v1;	quad[2].color = color;
+	//point 3, bottom right
+	quad[3].x = x + ax - bx;	quad[3].y = y + ay - by;	quad[3].z = 0.f;
+	quad[3].u = u2;	quad[3].v = v2;	quad[3].color = color;
+
+	quads++;
+}
+
+void SpriteBatch::AddSprites(GLuint texture, const B3D::SpriteArrays &sprites, size_t first, size_t count)
+{
+	if(texture != texId)
+	{
+		Flush();
+		texId = texture;
+	}
+
+	while(count > 0)
+	{
+		if(quads == maxQuads) Flush();
+
+		if(verts == NULL)
+		{
+			GLsizeiptr reservedBytes = 0;
+			verts = (B3D::BVertex *)stream->Reserve(sizeof(B3D::BVertex) * 4, sizeof(B3D::BVertex) * 4 * SPRITEBATCH_MAX_QUADS,
+				sizeof(B3D::BVertex), streamOffset, reservedBytes);
+			maxQuads = (int)(reservedBytes / (sizeof(B3D::BVertex) * 4));
+			quads = 0;
+		}
+
+		//as many as fit in what's left of the reservation
+		size_t n = std::min(count, (size_t)(maxQuads - quads));
+		B3D::TransformSprites(sprites, first, n, &verts[quads * 4]);
+
+		quads += (int)n;
+		first += n;
+		count -= n;
+	}
+}
+
+void SpriteBatch::AddSegment(const SpriteBatchSegment &segment)
+{
+	const B3D::BVertex *source = segment.verts.data();
+
+	for(const SpriteBatchSegment::Run &run : segment.runs)
+	{
+		if(run.texture != texId)
+		{
+			Flush();
+			texId = run.texture;
+		}
+
+		int remaining = run.quads;
+		while(remaining > 0)
+		{
+			if(quads == maxQuads) Flush();
+
+			if(verts == NULL)
+			{
+				GLsizeiptr reservedBytes = 0;
+				verts = (B3D::BVertex *)stream->Reserve(sizeof(B3D::BVertex) * 4, sizeof(B3D::BVertex) * 4 * SPRITEBATCH_MAX_QUADS,
+					sizeof(B3D::BVertex), streamOffset, reservedBytes);
+				maxQuads = (int)(reservedBytes / (sizeof(B3D::BVertex) * 4));
+				quads = 0;
+			}
+
+			//the vertices are already transformed, just copy them into the stream
+			int n = std::min(remaining, maxQuads - quads);
+			memcpy(&verts[quads * 4], source, sizeof(B3D::BVertex) * 4 * n);
+
+			source += n * 4;
+			quads += n;
+			remaining -= n;
+		}
+	}
+}
+
+void SpriteBatch::Flush(void)
+{
+	if(verts == NULL) return;
+
+	//hand the vertices we wrote back to the stream
+	stream->Commit(sizeof(B3D::BVertex) * 4 * quads);
+	verts = NULL;
+
+	if(quads == 0) return;
+
+	//whatever program the game is using gets restored afterwards
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	prog->use(); //the matrices come from the frame uniform block
+
+	b3d->tManager->BindTexture(texId);
+
+	glBindVertexArray(vaoId);
+
+	glDrawElementsBaseVertex(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, BUFFER_OFFSET(0),
+		(GLint)(streamOffset / sizeof(B3D::BVertex)));
+
+	glBindVertexArray(0);
+
+	glUseProgram(previousProgram);
+
+	drawCalls++;
+	quadCount += quads;
+	quads = 0;
+}
+
+void SpriteBatch::SetBlendFunc(GLenum src, GLenum dst)
+{
+	if(src == blendSrc && dst == blendDst) return;
+
+	//everything already in the batch was meant to be drawn with the old blend function
+	Flush();
+
+	blendSrc = src;
+	blendDst = dst;
+	glBlendFunc(src, dst);
+}
+
+void SpriteBatch::SetShader(GLSLProgram *shader)
+{
+	if(shader == prog) return;
+
+	Flush();
+	prog = shader;
+}
+
+void SpriteBatch::EndFrame(void)
+{
+	lastFrameDrawCalls = drawCalls;
+	lastFrameQuadCount = quadCount;
+	drawCalls = quadCount = 0;
+}
+
+//SpriteBatchSegment ---------------------------------------------------------------
+void SpriteBatchSegment::AddSprite(GLuint texture, GLfloat halfWidth, GLfloat halfHeight,
+	GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2,
+	GLfloat x, GLfloat y, GLfloat angle, GLfloat scaleX, GLfloat scaleY, GLuint color)
+{
+	if(runs.empty() || runs.back().texture != texture)
+	{
+		Run run;
+		run.texture = texture;
+		run.quads = 0;
+		runs.push_back(run);
+	}
+
+	//same corner math as SpriteBatch::AddSprite()
+	float radians = glm::radians(angle);
+	float c = cosf(radians);
+	float s = sinf(radians);
+
+	float hx = halfWidth * scaleX;
+	float hy = halfHeight * scaleY;
+
+	float ax = hx * c, ay = hx * s;
+	float bx = -hy * s, by = hy * c;
+
+	size_t first = verts.size();
+	verts.resize(first + 4);
+	B3D::BVertex *quad = &verts[first];
+
+	quad[0].x = x - ax + bx;	quad[0].y = y - ay + by;	quad[0].z = 0.f;
+	quad[0].u = u1;	quad[0].v = v1;	quad[0].color = color;
+	quad[1].x = x - ax - bx;	quad[1].y = y - ay - by;	quad[1].z = 0.f;
+	quad[1].u = u1;	quad[1].v = v2;	quad[1].color = color;
+	quad[2].x = x + ax + bx;	quad[2].y = y + ay + by;	quad[2].z = 0.f;
+	quad[2].u = u2;	quad[2].v = v1;	quad[2].color = color;
+	quad[3].x = x + ax - bx;	quad[3].y = y + ay - by;	quad[3].z = 0.f;
+	quad[3].u = u2;	quad[3].v = v2;	quad[3].color = color;
+
+	runs.back().quads++;
+}
+
+void SpriteBatchSegment::AddSprites(GLuint texture, const B3D::SpriteArrays &sprites, size_t first, size_t count)
+{
+	if(count == 0) return;
+
+	if(runs.empty() || runs.back().texture != texture)
+	{
+		Run run;
+		run.texture = texture;
+		run.quads = 0;
+		runs.push_back(run);
+	}
+
+	size_t start = verts.size();
+	verts.resize(start + count * 4);
+	B3D::TransformSprites(sprites, first, count, &verts[start]);
+
+	runs.back().quads += (int)count;
+}
+
+void SpriteBatchSegment::Clear(void)
+{
+	verts.clear();
+	runs.clear();
+	visibleCount = culledCount = 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+/*
+	Sprite batching for 2D mode.
+
+	When batching is enabled (Blit3D::SetSpriteBatching(true)), Sprite::Blit() no longer
+	draws anything itself: it transforms its four corners on the CPU and writes them straight
+	into the Blit3D StreamBuffer. AngelcodeFont text joins the batch the same way. The batch is
+	drawn with a single glDrawElementsBaseVertex() call whenever the texture, shader or blend
+	state changes, when it fills up, or right before glfwSwapBuffers() in Blit3D::Run().
+
+	If you make your own OpenGL draw calls in the middle of Draw(), call blit3D->Flush() first
+	so that any sprites queued before your draw end up underneath it.
+*/
+#include "Blit3D.h"
+#include <vector>
+
+class Blit3D;
+class StreamBuffer;
+
+namespace B3D
+{
+	class SpriteArrays;
+}
+
+namespace B3D
+{
+	//structure to store vertex info for batched sprites:
+	//positions are already transformed into world coordinates
+	class BVertex
+	{
+	public:
+		GLfloat x, y, z;//position
+		GLfloat u, v; //texture coordinates
+		GLuint color; //RGBA tint of the sprite this vertex belongs to, alpha included (see PackColor())
+	};
+
+	//packs a tint into 4 bytes, red in the lowest byte so it reads as r, g, b, a in memory
+	inline GLuint PackColor(float r, float g, float b, float a)
+	{
+		return (GLuint)(glm::clamp(r, 0.f, 1.f) * 255.f + 0.5f)
+			| ((GLuint)(glm::clamp(g, 0.f, 1.f) * 255.f + 0.5f) << 8)
+			| ((GLuint)(glm::clamp(b, 0.f, 1.f) * 255.f + 0.5f) << 16)
+			| ((GLuint)(glm::clamp(a, 0.f, 1.f) * 255.f + 0.5f) << 24);
+	}
+
+	inline GLuint PackColor(const glm::vec4 &color)
+	{
+		return PackColor(color.r, color.g, color.b, color.a);
+	}
+}
+
+//maximum number of sprites drawn by a single flush of the batch
+#define SPRITEBATCH_MAX_QUADS 8192
+
+/*
+	A chunk of pre-transformed quads built off the GL thread.
+
+	Give each worker thread its own segment (Blit3D::MakeBatchSegment()), fill it with
+	Sprite::BlitToSegment() or AddSprite(), then hand the segments to
+	Blit3D::SubmitBatchSegment() on the GL thread, in the order they should be drawn.
+	Segments never make OpenGL calls, so filling them is safe from any thread, as long as
+	only one thread writes to a given segment at a time.
+*/
+class SpriteBatchSegment
+{
+public:
+	//a run of quads that share a texture
+	class Run
+	{
+	public:
+		GLuint texture;
+		int quads;
+	};
+
+	std::vector<B3D::BVertex> verts; //4 per quad
+	std::vector<Run> runs;
+	int visibleCount, culledCount; //camera culling by Sprite::BlitToSegment(), handed to Camera2D on submit
+
+	SpriteBatchSegment() : visibleCount(0), culledCount(0) {}
+
+	void AddSprite(GLuint texture, GLfloat halfWidth, GLfloat halfHeight,
+		GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2,
+		GLfloat x, GLfloat y, GLfloat angle, GLfloat scaleX, GLfloat scaleY, GLuint color);
+	void AddSprites(GLuint texture, const B3D::SpriteArrays &sprites, size_t first, size_t count); //uses the SIMD transform kernel
+	void Clear(void); //keeps the memory around for next frame
+};
+
+class SpriteBatch
+{
+private:
+	StreamBuffer *stream; //where the vertices live
+	B3D::BVertex *verts; //our open reservation in the stream, NULL if we don't have one
+	GLsizeiptr streamOffset; //byte offset of verts in the stream's buffer
+	int quads; //sprites written into the reservation so far
+	int maxQuads; //sprites the reservation has room for
+	GLuint iboId;	// ID of the index buffer
+	GLuint vaoId;	//ID of the VAO
+
+	GLuint texId; //texture used by the quads currently in the batch
+	GLenum blendSrc, blendDst; //current blend function
+	Blit3D *b3d;
+	GLSLProgram *prog; //shader for pre-transformed sprites, the built-in one unless SetShader() changed it
+
+public:
+	bool active; //true when Sprite::Blit() should add to the batch instead of drawing
+	int drawCalls; //draw calls issued by the batch so far this frame
+	int quadCount; //sprites drawn by the batch so far this frame
+	int lastFrameDrawCalls, lastFrameQuadCount; //totals for the previous frame
+
+	SpriteBatch(Blit3D *blit3d, GLSLProgram *shader, StreamBuffer *streamBuffer);
+	~SpriteBatch();
+
+	//adds a sprite quad to the batch, flushing first if the texture changed or the batch is full
+	void AddSprite(GLuint texture, GLfloat halfWidth, GLfloat halfHeight,
+		GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2,
+		GLfloat x, GLfloat y, GLfloat angle, GLfloat scaleX, GLfloat scaleY, GLuint color);
+	//adds sprites first..first+count-1 from the arrays, all on one texture, using the SIMD transform kernel
+	void AddSprites(GLuint texture, const B3D::SpriteArrays &sprites, size_t first, size_t count);
+	void AddSegment(const SpriteBatchSegment &segment); //copies a segment's quads into the batch, GL thread only
+	void Flush(void); //draw everything in the batch
+	void SetBlendFunc(GLenum src, GLenum dst); //changes glBlendFunc(), flushing the batch if needed
+	void GetBlendFunc(GLenum &src, GLenum &dst) { src = blendSrc; dst = blendDst; }
+	void SetShader(GLSLProgram *shader); //must take the same vertex layout as the built-in shader; flushes if needed
+	GLSLProgram *GetShader(void) { return prog; }
+	void EndFrame(void); //called by Blit3D once per frame to roll the stats over
+};
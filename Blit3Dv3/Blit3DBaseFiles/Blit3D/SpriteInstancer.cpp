@@ -0,0 +1,140 @@
+#include "SpriteInstancer.h"
+
+extern logger oLog;
+
+SpriteInstancer::SpriteInstancer(Blit3D *blit3d, GLSLProgram *shader, StreamBuffer *streamBuffer)
+{
+	b3d = blit3d;
+	prog = shader;
+	stream = streamBuffer;
+
+	drawCalls = instanceCount = 0;
+	lastFrameDrawCalls = lastFrameInstanceCount = 0;
+
+	//unit quad as a triangle strip: corner position, then texture coordinate across the quad
+	/*
+
+	0-------2
+	|       |
+	|       |
+	|       |
+	1-------3
+	*/
+	GLfloat quad[] = {
+		-1.f,  1.f,		0.f, 0.f,
+		-1.f, -1.f,		0.f, 1.f,
+		 1.f,  1.f,		1.f, 0.f,
+		 1.f, -1.f,		1.f, 1.f
+	};
+
+	glGenVertexArrays(1, &vaoId);
+	glBindVertexArray(vaoId);
+
+	glGenBuffers(1, &quadVboId);
+	glBindBuffer(GL_ARRAY_BUFFER, quadVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, BUFFER_OFFSET(0)); //corner
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, BUFFER_OFFSET(sizeof(GLfloat) * 2)); //texcoord
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	//instance data comes from the stream buffer, each draw call picks its spot with a base instance
+	glBindBuffer(GL_ARRAY_BUFFER, stream->GetBuffer());
+
+	//per-instance attributes advance once per sprite instead of once per vertex
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::SpriteInstance), BUFFER_OFFSET(0)); //x, y, angle
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(B3D::SpriteInstance), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //color
+	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::SpriteInstance), BUFFER_OFFSET(sizeof(GLfloat) * 4)); //half-size
+	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(B3D::SpriteInstance), BUFFER_OFFSET(sizeof(GLfloat) * 6)); //UV rect
+	glVertexAttribDivisor(2, 1);
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
+	glVertexAttribDivisor(5, 1);
+	glEnableVertexAttribArray(2);
+	glEnableVertexAttribArray(3); //Color channel carries the tint
+	glEnableVertexAttribArray(4);
+	glEnableVertexAttribArray(5);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	oLog(Level::Info) << "Created SpriteInstancer";
+}
+
+SpriteInstancer::~SpriteInstancer()
+{
+	glDeleteBuffers(1, &quadVboId);
+	glDeleteVertexArrays(1, &vaoId);
+}
+
+void SpriteInstancer::AddInstance(GLuint texture, const B3D::SpriteInstance &instance)
+{
+	std::vector<B3D::SpriteInstance> &instances = instanceMap[texture];
+	if(instances.empty()) textureOrder.push_back(texture);
+	instances.push_back(instance);
+}
+
+B3D::SpriteInstance *SpriteInstancer::AddInstances(GLuint texture, size_t count)
+{
+	std::vector<B3D::SpriteInstance> &instances = instanceMap[texture];
+	if(instances.empty()) textureOrder.push_back(texture);
+
+	size_t first = instances.size();
+	instances.resize(first + count);
+	return instances.data() + first;
+}
+
+void SpriteInstancer::Flush(void)
+{
+	if(textureOrder.empty()) return;
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	prog->use(); //the matrices come from the frame uniform block
+
+	glBindVertexArray(vaoId);
+
+	//one draw call per texture, more only if the instances don't fit in what's left of the stream segment
+	for(GLuint texture : textureOrder)
+	{
+		std::vector<B3D::SpriteInstance> &instances = instanceMap[texture];
+		b3d->tManager->BindTexture(texture);
+
+		size_t first = 0;
+		while(first < instances.size())
+		{
+			GLsizeiptr offset = 0;
+			GLsizeiptr reservedBytes = 0;
+			B3D::SpriteInstance *dest = (B3D::SpriteInstance *)stream->Reserve(sizeof(B3D::SpriteInstance),
+				sizeof(B3D::SpriteInstance) * (instances.size() - first), sizeof(B3D::SpriteInstance), offset, reservedBytes);
+
+			GLsizei count = (GLsizei)(reservedBytes / sizeof(B3D::SpriteInstance));
+			memcpy(dest, &instances[first], sizeof(B3D::SpriteInstance) * count);
+			stream->Commit(sizeof(B3D::SpriteInstance) * count);
+
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, count, (GLuint)(offset / sizeof(B3D::SpriteInstance)));
+
+			first += count;
+			drawCalls++;
+			instanceCount += count;
+		}
+
+		//keep the vector's memory around for next frame
+		instances.clear();
+	}
+
+	glBindVertexArray(0);
+
+	glUseProgram(previousProgram);
+
+	textureOrder.clear();
+}
+
+void SpriteInstancer::EndFrame(void)
+{
+	lastFrameDrawCalls = drawCalls;
+	lastFrameInstanceCount = instanceCount;
+	drawCalls = instanceCount = 0;
+}
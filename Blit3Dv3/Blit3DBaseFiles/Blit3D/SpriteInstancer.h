@@ -0,0 +1,62 @@
+#pragma once
+/*
+	Instanced sprite rendering.
+
+	Sprite::BlitInstanced() records one instance (position, angle, scale, tint and UV rect)
+	instead of drawing. At the next Blit3D::Flush() (at the latest, right before the buffers are
+	swapped) every texture gets exactly one glDrawArraysInstanced() call, using a single shared
+	unit-quad VAO. Meant for huge numbers of identical sprites, such as bullets. The instance data
+	is written into the Blit3D StreamBuffer and picked out with the base instance of each draw.
+
+	Instances are grouped by texture, so the draw order between different textures is the order
+	in which each texture was first used since the last flush, not the order of the calls.
+*/
+#include "Blit3D.h"
+#include <vector>
+#include <unordered_map>
+
+class Blit3D;
+class StreamBuffer;
+
+namespace B3D
+{
+	//per-instance data for the instanced sprite shader
+	class SpriteInstance
+	{
+	public:
+		GLfloat x, y; //world coordinates of the center of the sprite
+		GLfloat angle; //rotation in radians
+		GLuint color; //RGBA tint, alpha included, see PackColor()
+		GLfloat halfWidth, halfHeight; //half-size of the quad, already scaled
+		GLfloat u1, v1, u2, v2; //texture coordinates of the top-left and bottom-right corners
+	};
+}
+
+class SpriteInstancer
+{
+private:
+	GLuint quadVboId; //the shared unit quad
+	GLuint vaoId;
+	StreamBuffer *stream; //where the per-instance data lives
+
+	//instances waiting to be drawn, grouped by texture
+	std::unordered_map<GLuint, std::vector<B3D::SpriteInstance>> instanceMap;
+	std::vector<GLuint> textureOrder; //textures in the order they were first used
+
+	Blit3D *b3d;
+	GLSLProgram *prog; //built-in instanced sprite shader
+
+public:
+	int drawCalls; //draw calls issued so far this frame
+	int instanceCount; //instances drawn so far this frame
+	int lastFrameDrawCalls, lastFrameInstanceCount; //totals for the previous frame
+
+	SpriteInstancer(Blit3D *blit3d, GLSLProgram *shader, StreamBuffer *streamBuffer);
+	~SpriteInstancer();
+
+	void AddInstance(GLuint texture, const B3D::SpriteInstance &instance);
+	//makes room for count instances and returns them for the caller to fill in before the next flush
+	B3D::SpriteInstance *AddInstances(GLuint texture, size_t count);
+	void Flush(void); //one instanced draw call per texture
+	void EndFrame(void); //called by Blit3D once per frame to roll the stats over
+};
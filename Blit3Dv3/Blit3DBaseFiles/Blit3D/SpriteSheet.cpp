@@ -0,0 +1,164 @@
+#include "SpriteSheet.h"
+
+extern logger oLog;
+
+SpriteSheet::SpriteSheet(std::string TextureFileName, TextureManager *TexManager)
+{
+	refcount = 0;
+	uploadedRegions = 0;
+	textureName = TextureFileName;
+	texManager = TexManager;
+
+	//load the texture via the texture manager, once for the whole sheet
+	texHandle = texManager->Load(TextureFileName);
+	texId = texManager->TextureId(texHandle);
+	if(texId == 0)
+	{
+		oLog(Level::Severe) << "Image loading error while loading image file: " << TextureFileName << "for SpriteSheet";
+		assert(texId != 0);
+	}
+
+	texManager->FetchDimensions(texHandle, textureWidth, textureHeight);
+
+	// generate a new VAO and VBO, the VBO gets filled the first time we are drawn
+	glGenVertexArrays(1, &vaoId);
+	glGenBuffers(1, &vboId);
+}
+
+SpriteSheet::SpriteSheet(RenderBuffer *rb, TextureManager *TexManager)
+{
+	refcount = 0;
+	uploadedRegions = 0;
+	textureName = rb->texname;
+	texManager = TexManager;
+
+	//get the texture from the renderBuffer
+	texId = rb->color_tex;
+	textureWidth = (GLfloat)rb->texwidth;
+	textureHeight = (GLfloat)rb->texheight;
+
+	//increment our use of this texture
+	texHandle = texManager->AddLoadedTexture(textureName, texId);
+
+	glGenVertexArrays(1, &vaoId);
+	glGenBuffers(1, &vboId);
+}
+
+SpriteSheet::~SpriteSheet()
+{
+	// free texture
+	texManager->FreeTexture(texHandle);
+
+	// delete VBO when object destroyed
+	glDeleteBuffers(1, &vboId);
+	glDeleteVertexArrays(1, &vaoId);
+}
+
+int SpriteSheet::AddRegion(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, bool rotated, GLfloat offsetX, GLfloat offsetY)
+{
+	std::array<GLfloat, 7> key = { startX, startY, width, height, rotated ? 1.f : 0.f, offsetX, offsetY };
+	std::map<std::array<GLfloat, 7>, int>::iterator itr = regionLookup.find(key);
+	if(itr != regionLookup.end()) return itr->second;
+
+	B3D::SpriteRegion region;
+	region.x = startX;
+	region.y = startY;
+	region.width = width;
+	region.height = height;
+
+	region.halfWidth = width / 2.f;
+	region.halfHeight = height / 2.f;
+
+	region.u1 = startX / textureWidth;
+	region.u2 = (startX + width) / textureWidth;
+
+	region.v1 = 1.f - (startY / textureHeight);
+	region.v2 = 1.f - ((startY + height) / textureHeight);
+
+	region.rotated = rotated;
+	region.offsetX = offsetX;
+	region.offsetY = offsetY;
+
+	int index = (int)regions.size();
+	regions.push_back(region);
+	regionLookup[key] = index;
+
+	return index;
+}
+
+void SpriteSheet::Bind(void)
+{
+	glBindVertexArray(vaoId); // Bind our Vertex Array Object
+
+	if(uploadedRegions == regions.size()) return;
+
+	//new regions were cut since we last uploaded: rebuild the whole buffer in one go
+	B3D::TVertex *verts = new B3D::TVertex[4 * regions.size()]; //make an array of Textured Vertices
+
+	/*
+
+	0-------2
+	|       |
+	|       |
+	|       |
+	1-------3
+	*/
+
+	for(size_t i = 0; i < regions.size(); ++i)
+	{
+		B3D::SpriteRegion &r = regions[i];
+		B3D::TVertex *quad = &verts[i * 4];
+
+		//the quad is upright here, so a rotated region is as wide as its rect is tall
+		GLfloat hw = r.rotated ? r.halfHeight : r.halfWidth;
+		GLfloat hh = r.rotated ? r.halfWidth : r.halfHeight;
+
+		//point 0
+		quad[0].x = r.offsetX - hw;				quad[0].y = r.offsetY + hh;			quad[0].z = 0.f;
+		//point 1
+		quad[1].x = r.offsetX - hw;				quad[1].y = r.offsetY - hh;		quad[1].z = 0.f;
+		//point 2
+		quad[2].x = r.offsetX + hw;				quad[2].y = r.offsetY + hh;			quad[2].z = 0.f;
+		//point 3
+		quad[3].x = r.offsetX + hw;				quad[3].y = r.offsetY - hh;		quad[3].z = 0.f;
+
+		if(r.rotated)
+		{
+			//the image was turned clockwise onto the texture, so its top-left corner is the rect's top-right, etc.
+			quad[0].u = r.u2;	quad[0].v = r.v1;
+			quad[1].u = r.u1;	quad[1].v = r.v1;
+			quad[2].u = r.u2;	quad[2].v = r.v2;
+			quad[3].u = r.u1;	quad[3].v = r.v2;
+		}
+		else
+		{
+			quad[0].u = r.u1;	quad[0].v = r.v1;
+			quad[1].u = r.u1;	quad[1].v = r.v2;
+			quad[2].u = r.u2;	quad[2].v = r.v1;
+			quad[3].u = r.u2;	quad[3].v = r.v2;
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4 * regions.size(), verts, GL_STATIC_DRAW);
+
+	if(uploadedRegions == 0)
+	{
+		//first upload, so set up our vertex attributes pointers
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //Start after x,y,z data
+
+		// activate attribute array
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glDisableVertexAttribArray(2); //don't use channel 2
+		glDisableVertexAttribArray(3); //don't use Color channel, we are textured
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
+
+	//free the memory once it's been uploaded
+	delete[] verts;
+
+	uploadedRegions = regions.size();
+}
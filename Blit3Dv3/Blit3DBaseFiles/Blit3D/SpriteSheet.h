@@ -0,0 +1,83 @@
+#pragma once
+/*
+	Shared geometry for all the sprites cut from one texture.
+
+	A SpriteSheet loads its texture once and keeps a table of regions (the rectangles that
+	sprites were cut from) along with a single VBO holding 4 vertices per region. A Sprite is
+	then just a pointer to its sheet plus a region index, so a 400-frame spritesheet costs one
+	texture lookup, one VAO and one VBO instead of 400 of each.
+
+	Sheets are created and reference counted by Blit3D, never create or delete one yourself.
+*/
+#include "Blit3D.h"
+#include <vector>
+#include <map>
+#include <array>
+#include <algorithm>
+
+class Blit3D;
+class RenderBuffer;
+
+namespace B3D
+{
+	//a rectangle cut out of a SpriteSheet
+	class SpriteRegion
+	{
+	public:
+		GLfloat x, y, width, height; //pixel rect on the texture, from the top-left corner
+		GLfloat halfWidth, halfHeight; //half-dimensions of the quad, as the rect lies on the texture
+		GLfloat u1, v1, u2, v2; //texture coordinates of the top-left and bottom-right corners
+		bool rotated; //the rect holds the image turned 90 degrees clockwise (packed atlases), so it is drawn turned back
+		GLfloat offsetX, offsetY; //where the quad's center sits relative to the sprite's position (trimmed atlas frames), y up
+
+		//turns a sprite's position, angle (degrees) and scale into the quad to draw for the paths that take a
+		//UV rect: moves it by the offset, and for rotated regions turns the quad back a quarter turn and swaps
+		//the scales, which draws the same as rotating the UVs
+		void Place(float &x, float &y, float &angle, float &scaleX, float &scaleY) const
+		{
+			if(offsetX != 0.f || offsetY != 0.f)
+			{
+				float radians = glm::radians(angle);
+				float c = cosf(radians);
+				float s = sinf(radians);
+				float ox = offsetX * scaleX;
+				float oy = offsetY * scaleY;
+				x += ox * c - oy * s;
+				y += ox * s + oy * c;
+			}
+
+			if(rotated)
+			{
+				angle += 90.f;
+				std::swap(scaleX, scaleY);
+			}
+		}
+	};
+}
+
+class SpriteSheet
+{
+private:
+	std::map<std::array<GLfloat, 7>, int> regionLookup; //so identical rects share a region
+	GLuint vboId;	// ID of VBO
+	GLuint vaoId;	//ID of the VAO
+	size_t uploadedRegions; //how many regions the VBO currently holds
+	TextureManager *texManager;
+
+public:
+	std::string textureName; //filename of the texture
+	GLuint texId; //ID of texture
+	TextureHandle texHandle; //our reference in the texture manager
+	GLfloat textureWidth, textureHeight;
+	std::vector<B3D::SpriteRegion> regions;
+	int refcount; //how many sprites are using this sheet
+
+	SpriteSheet(std::string TextureFileName, TextureManager *TexManager);
+	SpriteSheet(RenderBuffer *rb, TextureManager *TexManager);
+	~SpriteSheet();
+
+	//returns the index of the region for this pixel rect, adding it if it is new; see SpriteRegion for rotated and the offset
+	int AddRegion(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, bool rotated = false, GLfloat offsetX = 0.f, GLfloat offsetY = 0.f);
+	//binds our VAO, uploading any regions added since the last upload
+	void Bind(void);
+};
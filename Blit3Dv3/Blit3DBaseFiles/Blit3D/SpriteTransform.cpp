@@ -0,0 +1,407 @@
+#include "Blit3D.h"
+#include <vector>
+#include <chrono>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define B3D_SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define B3D_TARGET_AVX2
+	#else
+		#define B3D_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+extern logger oLog;
+
+//polynomial coefficients for sin/cos on [-pi/4, pi/4]
+#define SINCOS_S1 -1.6666654611e-1f
+#define SINCOS_S2 8.3321608736e-3f
+#define SINCOS_S3 -1.9515295891e-4f
+#define SINCOS_C1 4.166664568298827e-2f
+#define SINCOS_C2 -1.388731625493765e-3f
+#define SINCOS_C3 2.443315711809948e-5f
+#define SINCOS_DEG2RAD 0.01745329251994329577f
+
+//the angle is reduced to [-45, 45] degrees by subtracting a whole number of quarter turns (quadrant),
+//then sin/cos of the remainder are swapped and negated according to the quadrant
+static void SinCosDegrees(float degrees, float &s, float &c)
+{
+	float quadrant = floorf(degrees * (1.f / 90.f) + 0.5f);
+	int q = (int)quadrant;
+	float r = (degrees - quadrant * 90.f) * SINCOS_DEG2RAD;
+	float r2 = r * r;
+
+	float sp = r + r * r2 * (SINCOS_S1 + r2 * (SINCOS_S2 + r2 * SINCOS_S3));
+	float cp = 1.f - 0.5f * r2 + r2 * r2 * (SINCOS_C1 + r2 * (SINCOS_C2 + r2 * SINCOS_C3));
+
+	if(q & 1)
+	{
+		float t = sp;
+		sp = cp;
+		cp = t;
+	}
+
+	s = (q & 2) ? -sp : sp;
+	c = ((q + 1) & 2) ? -cp : cp;
+}
+
+//writes one quad, corners in the SpriteBatch order: top left, bottom left, top right, bottom right
+static inline void WriteQuad(B3D::BVertex *quad, const B3D::SpriteArrays &sp, size_t i,
+	float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3)
+{
+	GLuint color = sp.color[i];
+	float z = sp.z[i];
+
+	quad[0].x = x0;	quad[0].y = y0;	quad[0].z = z;
+	quad[0].u = sp.u1[i];	quad[0].v = sp.v1[i];	quad[0].color = color;
+	quad[1].x = x1;	quad[1].y = y1;	quad[1].z = z;
+	quad[1].u = sp.u1[i];	quad[1].v = sp.v2[i];	quad[1].color = color;
+	quad[2].x = x2;	quad[2].y = y2;	quad[2].z = z;
+	quad[2].u = sp.u2[i];	quad[2].v = sp.v1[i];	quad[2].color = color;
+	quad[3].x = x3;	quad[3].y = y3;	quad[3].z = z;
+	quad[3].u = sp.u2[i];	quad[3].v = sp.v2[i];	quad[3].color = color;
+}
+
+static void TransformScalar(const B3D::SpriteArrays &sp, size_t first, size_t count, B3D::BVertex *out)
+{
+	for(size_t n = 0; n < count; ++n)
+	{
+		size_t i = first + n;
+
+		float s, c;
+		SinCosDegrees(sp.angle[i], s, c);
+
+		float hx = sp.halfWidth[i] * sp.scaleX[i];
+		float hy = sp.halfHeight[i] * sp.scaleY[i];
+
+		//rotated half-extent vectors
+		float ax = hx * c, ay = hx * s;
+		float bx = -hy * s, by = hy * c;
+		float x = sp.x[i], y = sp.y[i];
+
+		WriteQuad(&out[n * 4], sp, i,
+			x - ax + bx, y - ay + by,
+			x - ax - bx, y - ay - by,
+			x + ax + bx, y + ay + by,
+			x + ax - bx, y + ay - by);
+	}
+}
+
+#ifdef B3D_SIMD_X86
+static inline void SinCosDegreesSSE2(__m128 degrees, __m128 &s, __m128 &c)
+{
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(degrees, _mm_set1_ps(1.f / 90.f))); //round to nearest
+	__m128 quadrant = _mm_cvtepi32_ps(q);
+	__m128 r = _mm_mul_ps(_mm_sub_ps(degrees, _mm_mul_ps(quadrant, _mm_set1_ps(90.f))), _mm_set1_ps(SINCOS_DEG2RAD));
+	__m128 r2 = _mm_mul_ps(r, r);
+
+	__m128 sp = _mm_add_ps(_mm_set1_ps(SINCOS_S2), _mm_mul_ps(r2, _mm_set1_ps(SINCOS_S3)));
+	sp = _mm_add_ps(_mm_set1_ps(SINCOS_S1), _mm_mul_ps(r2, sp));
+	sp = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+
+	__m128 cp = _mm_add_ps(_mm_set1_ps(SINCOS_C2), _mm_mul_ps(r2, _mm_set1_ps(SINCOS_C3)));
+	cp = _mm_add_ps(_mm_set1_ps(SINCOS_C1), _mm_mul_ps(r2, cp));
+	cp = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+
+	//odd quadrants swap sin and cos
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sr = _mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp));
+	__m128 cr = _mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp));
+
+	//bit 1 of the quadrant becomes the sign bit
+	__m128 signS = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+	__m128 signC = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+	s = _mm_xor_ps(sr, signS);
+	c = _mm_xor_ps(cr, signC);
+}
+
+static void TransformSSE2(const B3D::SpriteArrays &sp, size_t first, size_t count, B3D::BVertex *out)
+{
+	alignas(16) float corners[8][4];
+	size_t n = 0;
+
+	for(; n + 4 <= count; n += 4)
+	{
+		size_t i = first + n;
+
+		__m128 s, c;
+		SinCosDegreesSSE2(_mm_loadu_ps(&sp.angle[i]), s, c);
+
+		__m128 hx = _mm_mul_ps(_mm_loadu_ps(&sp.halfWidth[i]), _mm_loadu_ps(&sp.scaleX[i]));
+		__m128 hy = _mm_mul_ps(_mm_loadu_ps(&sp.halfHeight[i]), _mm_loadu_ps(&sp.scaleY[i]));
+
+		__m128 ax = _mm_mul_ps(hx, c), ay = _mm_mul_ps(hx, s);
+		__m128 bx = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(hy, s)), by = _mm_mul_ps(hy, c);
+		__m128 x = _mm_loadu_ps(&sp.x[i]), y = _mm_loadu_ps(&sp.y[i]);
+
+		__m128 xMinusA = _mm_sub_ps(x, ax), yMinusA = _mm_sub_ps(y, ay);
+		__m128 xPlusA = _mm_add_ps(x, ax), yPlusA = _mm_add_ps(y, ay);
+
+		_mm_store_ps(corners[0], _mm_add_ps(xMinusA, bx));	_mm_store_ps(corners[1], _mm_add_ps(yMinusA, by));
+		_mm_store_ps(corners[2], _mm_sub_ps(xMinusA, bx));	_mm_store_ps(corners[3], _mm_sub_ps(yMinusA, by));
+		_mm_store_ps(corners[4], _mm_add_ps(xPlusA, bx));	_mm_store_ps(corners[5], _mm_add_ps(yPlusA, by));
+		_mm_store_ps(corners[6], _mm_sub_ps(xPlusA, bx));	_mm_store_ps(corners[7], _mm_sub_ps(yPlusA, by));
+
+		for(int k = 0; k < 4; ++k)
+		{
+			WriteQuad(&out[(n + k) * 4], sp, i + k,
+				corners[0][k], corners[1][k], corners[2][k], corners[3][k],
+				corners[4][k], corners[5][k], corners[6][k], corners[7][k]);
+		}
+	}
+
+	//leftovers
+	TransformScalar(sp, first + n, count - n, &out[n * 4]);
+}
+
+B3D_TARGET_AVX2 static inline void SinCosDegreesAVX2(__m256 degrees, __m256 &s, __m256 &c)
+{
+	__m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(degrees, _mm256_set1_ps(1.f / 90.f))); //round to nearest
+	__m256 quadrant = _mm256_cvtepi32_ps(q);
+	__m256 r = _mm256_mul_ps(_mm256_sub_ps(degrees, _mm256_mul_ps(quadrant, _mm256_set1_ps(90.f))), _mm256_set1_ps(SINCOS_DEG2RAD));
+	__m256 r2 = _mm256_mul_ps(r, r);
+
+	__m256 sp = _mm256_add_ps(_mm256_set1_ps(SINCOS_S2), _mm256_mul_ps(r2, _mm256_set1_ps(SINCOS_S3)));
+	sp = _mm256_add_ps(_mm256_set1_ps(SINCOS_S1), _mm256_mul_ps(r2, sp));
+	sp = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sp));
+
+	__m256 cp = _mm256_add_ps(_mm256_set1_ps(SINCOS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SINCOS_C3)));
+	cp = _mm256_add_ps(_mm256_set1_ps(SINCOS_C1), _mm256_mul_ps(r2, cp));
+	cp = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), cp));
+
+	//odd quadrants swap sin and cos
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	__m256 sr = _mm256_blendv_ps(sp, cp, swap);
+	__m256 cr = _mm256_blendv_ps(cp, sp, swap);
+
+	//bit 1 of the quadrant becomes the sign bit
+	__m256 signS = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+	__m256 signC = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+	s = _mm256_xor_ps(sr, signS);
+	c = _mm256_xor_ps(cr, signC);
+}
+
+B3D_TARGET_AVX2 static void TransformAVX2(const B3D::SpriteArrays &sp, size_t first, size_t count, B3D::BVertex *out)
+{
+	alignas(32) float corners[8][8];
+	size_t n = 0;
+
+	for(; n + 8 <= count; n += 8)
+	{
+		size_t i = first + n;
+
+		__m256 s, c;
+		SinCosDegreesAVX2(_mm256_loadu_ps(&sp.angle[i]), s, c);
+
+		__m256 hx = _mm256_mul_ps(_mm256_loadu_ps(&sp.halfWidth[i]), _mm256_loadu_ps(&sp.scaleX[i]));
+		__m256 hy = _mm256_mul_ps(_mm256_loadu_ps(&sp.halfHeight[i]), _mm256_loadu_ps(&sp.scaleY[i]));
+
+		__m256 ax = _mm256_mul_ps(hx, c), ay = _mm256_mul_ps(hx, s);
+		__m256 bx = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(hy, s)), by = _mm256_mul_ps(hy, c);
+		__m256 x = _mm256_loadu_ps(&sp.x[i]), y = _mm256_loadu_ps(&sp.y[i]);
+
+		__m256 xMinusA = _mm256_sub_ps(x, ax), yMinusA = _mm256_sub_ps(y, ay);
+		__m256 xPlusA = _mm256_add_ps(x, ax), yPlusA = _mm256_add_ps(y, ay);
+
+		_mm256_store_ps(corners[0], _mm256_add_ps(xMinusA, bx));	_mm256_store_ps(corners[1], _mm256_add_ps(yMinusA, by));
+		_mm256_store_ps(corners[2], _mm256_sub_ps(xMinusA, bx));	_mm256_store_ps(corners[3], _mm256_sub_ps(yMinusA, by));
+		_mm256_store_ps(corners[4], _mm256_add_ps(xPlusA, bx));	_mm256_store_ps(corners[5], _mm256_add_ps(yPlusA, by));
+		_mm256_store_ps(corners[6], _mm256_sub_ps(xPlusA, bx));	_mm256_store_ps(corners[7], _mm256_sub_ps(yPlusA, by));
+
+		for(int k = 0; k < 8; ++k)
+		{
+			WriteQuad(&out[(n + k) * 4], sp, i + k,
+				corners[0][k], corners[1][k], corners[2][k], corners[3][k],
+				corners[4][k], corners[5][k], corners[6][k], corners[7][k]);
+		}
+	}
+
+	//leftovers
+	TransformSSE2(sp, first + n, count - n, &out[n * 4]);
+}
+#endif
+
+void B3D::SpriteArrayBuffer::Clear(void)
+{
+	x.clear();	y.clear();	angle.clear();
+	scaleX.clear();	scaleY.clear();
+	halfWidth.clear();	halfHeight.clear();
+	u1.clear();	v1.clear();	u2.clear();	v2.clear();
+	color.clear();	z.clear();
+}
+
+void B3D::SpriteArrayBuffer::Push(GLfloat X, GLfloat Y, GLfloat Angle, GLfloat ScaleX, GLfloat ScaleY, GLfloat HalfWidth, GLfloat HalfHeight,
+	GLfloat U1, GLfloat V1, GLfloat U2, GLfloat V2, GLuint Color, GLfloat Z)
+{
+	x.push_back(X);	y.push_back(Y);	angle.push_back(Angle);
+	scaleX.push_back(ScaleX);	scaleY.push_back(ScaleY);
+	halfWidth.push_back(HalfWidth);	halfHeight.push_back(HalfHeight);
+	u1.push_back(U1);	v1.push_back(V1);	u2.push_back(U2);	v2.push_back(V2);
+	color.push_back(Color);	z.push_back(Z);
+}
+
+B3D::SpriteArrays B3D::SpriteArrayBuffer::Arrays(void)
+{
+	SpriteArrays sp;
+	sp.x = x.data();	sp.y = y.data();	sp.angle = angle.data();
+	sp.scaleX = scaleX.data();	sp.scaleY = scaleY.data();
+	sp.halfWidth = halfWidth.data();	sp.halfHeight = halfHeight.data();
+	sp.u1 = u1.data();	sp.v1 = v1.data();	sp.u2 = u2.data();	sp.v2 = v2.data();
+	sp.color = color.data();	sp.z = z.data();
+	return sp;
+}
+
+B3D::SimdLevel B3D::DetectSimdLevel(void)
+{
+#ifdef B3D_SIMD_X86
+	#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	//the OS has to save the YMM registers for us too
+	if(osxsave && avx && (_xgetbv(0) & 6) == 6 && maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		if(info[1] & (1 << 5)) return SimdLevel::AVX2;
+	}
+	#else
+	if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+	#endif
+
+	return SimdLevel::SSE2; //every x64 CPU has SSE2
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+const char *B3D::SimdLevelName(SimdLevel level)
+{
+	switch(level)
+	{
+	case SimdLevel::AVX2: return "AVX2";
+	case SimdLevel::SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
+
+void B3D::TransformSprites(SimdLevel level, const SpriteArrays &sprites, size_t first, size_t count, BVertex *out)
+{
+	switch(level)
+	{
+#ifdef B3D_SIMD_X86
+	case SimdLevel::AVX2:
+		TransformAVX2(sprites, first, count, out);
+		break;
+
+	case SimdLevel::SSE2:
+		TransformSSE2(sprites, first, count, out);
+		break;
+#endif
+	default:
+		TransformScalar(sprites, first, count, out);
+		break;
+	}
+}
+
+void B3D::TransformSprites(const SpriteArrays &sprites, size_t first, size_t count, BVertex *out)
+{
+	//the CPU doesn't change while we run, so only ask once
+	static SimdLevel level = DetectSimdLevel();
+
+	TransformSprites(level, sprites, first, count, out);
+}
+
+//how Sprite::Blit() used to do it: build a model matrix, then transform each corner
+static void TransformGLM(const B3D::SpriteArrays &sp, size_t count, B3D::BVertex *out)
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(sp.x[i], sp.y[i], 0.f));
+		modelMatrix = glm::rotate(modelMatrix, glm::radians(sp.angle[i]), glm::vec3(0.f, 0.f, 1.f));
+
+		float hx = sp.halfWidth[i] * sp.scaleX[i];
+		float hy = sp.halfHeight[i] * sp.scaleY[i];
+
+		glm::vec4 tl = modelMatrix * glm::vec4(-hx, hy, 0.f, 1.f);
+		glm::vec4 bl = modelMatrix * glm::vec4(-hx, -hy, 0.f, 1.f);
+		glm::vec4 tr = modelMatrix * glm::vec4(hx, hy, 0.f, 1.f);
+		glm::vec4 br = modelMatrix * glm::vec4(hx, -hy, 0.f, 1.f);
+
+		WriteQuad(&out[i * 4], sp, i, tl.x, tl.y, bl.x, bl.y, tr.x, tr.y, br.x, br.y);
+	}
+}
+
+void B3D::BenchmarkSpriteTransform(void)
+{
+	const size_t sizes[] = { 10000, 100000, 1000000 };
+	const int repeats = 5; //best of, to keep other processes out of the numbers
+
+	SimdLevel best = DetectSimdLevel();
+	oLog(Level::Info) << "Sprite transform benchmark, best kernel on this CPU: " << SimdLevelName(best);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(0.f, 1920.f);
+	std::uniform_real_distribution<float> rotation(-720.f, 720.f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.f);
+	std::uniform_real_distribution<float> size(4.f, 64.f);
+
+	for(size_t count : sizes)
+	{
+		SpriteArrayBuffer buffer;
+		for(size_t i = 0; i < count; ++i)
+		{
+			buffer.Push(position(rng), position(rng), rotation(rng), scale(rng), scale(rng), size(rng), size(rng),
+				0.f, 1.f, 1.f, 0.f, 0xFFFFFFFF);
+		}
+		SpriteArrays sp = buffer.Arrays();
+
+		std::vector<BVertex> reference(count * 4);
+		std::vector<BVertex> verts(count * 4);
+
+		double glmTime = 1e30;
+		for(int r = 0; r < repeats; ++r)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			TransformGLM(sp, count, reference.data());
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if(elapsed.count() < glmTime) glmTime = elapsed.count();
+		}
+
+		oLog(Level::Info) << count << " sprites, glm: " << glmTime << " ms";
+
+		for(int l = 0; l <= (int)best; ++l)
+		{
+			SimdLevel level = (SimdLevel)l;
+
+			double kernelTime = 1e30;
+			for(int r = 0; r < repeats; ++r)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				TransformSprites(level, sp, 0, count, verts.data());
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				if(elapsed.count() < kernelTime) kernelTime = elapsed.count();
+			}
+
+			//make sure we are fast AND right
+			float maxError = 0.f;
+			for(size_t i = 0; i < count * 4; ++i)
+			{
+				maxError = std::max(maxError, fabsf(verts[i].x - reference[i].x));
+				maxError = std::max(maxError, fabsf(verts[i].y - reference[i].y));
+			}
+
+			oLog(Level::Info) << count << " sprites, " << SimdLevelName(level) << ": " << kernelTime << " ms ("
+				<< glmTime / kernelTime << "x glm), max error " << maxError << " pixels";
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+/*
+	Bulk sprite transform kernels.
+
+	Takes sprites as separate arrays (position, angle, scale, half-size, UV rect, color) and
+	writes their rotated quad corners straight into B3D::BVertex memory, in the same corner
+	order the SpriteBatch uses. There are SSE2 (4 sprites at a time) and AVX2 (8 at a time)
+	versions plus a scalar fallback; TransformSprites() picks the best one the CPU supports
+	the first time it is called.
+
+	sin/cos are evaluated with a polynomial after reducing the angle by multiples of 90 degrees,
+	so every version gives the same result to within a float rounding error or two, and angles
+	don't lose precision when they get large.
+
+	BenchmarkSpriteTransform() times the kernels against the old per-sprite glm path
+	(glm::translate + glm::rotate + transforming each corner) and logs the results via oLog.
+	The numbers depend on the CPU and the build, so run it from a Release build on the machine you
+	care about; debug builds don't inline the kernels and make the glm path look far worse.
+*/
+//only needs the GL types, and DrawQueue.h needs this file complete, so no Blit3D.h here
+#include <GL/glew.h>
+#include <vector>
+
+namespace B3D
+{
+	class BVertex;
+
+	//sprites to transform, one array per field, all with the same number of entries
+	class SpriteArrays
+	{
+	public:
+		const GLfloat *x, *y; //world coordinates of the center of each sprite
+		const GLfloat *angle; //in degrees
+		const GLfloat *scaleX, *scaleY;
+		const GLfloat *halfWidth, *halfHeight;
+		const GLfloat *u1, *v1, *u2, *v2; //texture coordinates of the top-left and bottom-right corners
+		const GLuint *color; //packed RGBA tints, see B3D::PackColor()
+		const GLfloat *z; //vertex z, 0 except in the draw queue's depth mode
+	};
+
+	//growable storage for SpriteArrays, for code that collects sprites one at a time
+	class SpriteArrayBuffer
+	{
+	public:
+		std::vector<GLfloat> x, y, angle, scaleX, scaleY, halfWidth, halfHeight, u1, v1, u2, v2;
+		std::vector<GLuint> color;
+		std::vector<GLfloat> z;
+
+		void Clear(void);
+		void Push(GLfloat X, GLfloat Y, GLfloat Angle, GLfloat ScaleX, GLfloat ScaleY, GLfloat HalfWidth, GLfloat HalfHeight,
+			GLfloat U1, GLfloat V1, GLfloat U2, GLfloat V2, GLuint Color, GLfloat Z = 0.f);
+		size_t Size(void) { return x.size(); }
+		SpriteArrays Arrays(void); //pointers into the vectors, invalidated by Push()
+	};
+
+	enum class SimdLevel { SCALAR = 0, SSE2, AVX2 };
+
+	SimdLevel DetectSimdLevel(void); //best instruction set this CPU (and OS) supports
+	const char *SimdLevelName(SimdLevel level);
+
+	//writes count * 4 vertices to out, starting with sprite first
+	void TransformSprites(const SpriteArrays &sprites, size_t first, size_t count, BVertex *out);
+	//same, with a specific kernel; level must be supported by this CPU
+	void TransformSprites(SimdLevel level, const SpriteArrays &sprites, size_t first, size_t count, BVertex *out);
+
+	//times every supported kernel against the glm path for 10k, 100k and 1M sprites and logs the results
+	void BenchmarkSpriteTransform(void);
+}
@@ -0,0 +1,213 @@
+#include "StaticLayer.h"
+
+extern logger oLog;
+
+StaticLayer::StaticLayer(Blit3D *blit3d)
+{
+	b3d = blit3d;
+	iboId = 0;
+	indexQuads = 0;
+	drawCalls = 0;
+}
+
+StaticLayer::~StaticLayer()
+{
+	for(auto &item : buckets)
+	{
+		glDeleteBuffers(1, &item.second.vboId);
+		glDeleteVertexArrays(1, &item.second.vaoId);
+	}
+	buckets.clear();
+
+	if(iboId) glDeleteBuffers(1, &iboId);
+}
+
+int StaticLayer::Add(Sprite *sprite, float x, float y, float angle, float scaleX, float scaleY, float alpha)
+{
+	assert(sprite != NULL);
+
+	int id;
+	if(freeSlots.empty())
+	{
+		id = (int)members.size();
+		members.push_back(Member());
+	}
+	else
+	{
+		id = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	Member &m = members[id];
+	m.sprite = sprite;
+	m.texture = sprite->GetSheet()->texId;
+	m.x = x;
+	m.y = y;
+	m.angle = angle;
+	m.scaleX = scaleX;
+	m.scaleY = scaleY;
+	m.color = B3D::PackColor(sprite->color.r, sprite->color.g, sprite->color.b, sprite->color.a * alpha);
+
+	if(buckets.find(m.texture) == buckets.end())
+	{
+		Bucket bucket;
+		glGenVertexArrays(1, &bucket.vaoId);
+		glGenBuffers(1, &bucket.vboId);
+		bucket.quads = 0;
+		buckets[m.texture] = bucket;
+		textureOrder.push_back(m.texture);
+	}
+
+	dirtyTextures.insert(m.texture);
+	return id;
+}
+
+int StaticLayer::Add(Sprite *sprite, float x, float y)
+{
+	return Add(sprite, x, y, 0.f, 1.f, 1.f, 1.f);
+}
+
+void StaticLayer::Set(int id, float x, float y, float angle, float scaleX, float scaleY, float alpha)
+{
+	assert(id >= 0 && id < (int)members.size() && members[id].sprite != NULL && "StaticLayer::Set() on a removed sprite");
+
+	Member &m = members[id];
+	GLuint color = B3D::PackColor(m.sprite->color.r, m.sprite->color.g, m.sprite->color.b, m.sprite->color.a * alpha);
+	if(m.x == x && m.y == y && m.angle == angle && m.scaleX == scaleX && m.scaleY == scaleY && m.color == color) return;
+
+	m.x = x;
+	m.y = y;
+	m.angle = angle;
+	m.scaleX = scaleX;
+	m.scaleY = scaleY;
+	m.color = color;
+
+	dirtyTextures.insert(m.texture);
+}
+
+void StaticLayer::Remove(int id)
+{
+	assert(id >= 0 && id < (int)members.size() && members[id].sprite != NULL && "StaticLayer::Remove() on a removed sprite");
+
+	dirtyTextures.insert(members[id].texture);
+	members[id].sprite = NULL;
+	freeSlots.push_back(id);
+}
+
+void StaticLayer::Clear(void)
+{
+	for(int i = 0; i < (int)members.size(); ++i)
+	{
+		if(members[i].sprite != NULL) Remove(i);
+	}
+}
+
+void StaticLayer::Rebuild(GLuint texture)
+{
+	Bucket &bucket = buckets[texture];
+
+	//gather this texture's sprites for the transform kernel
+	B3D::SpriteArrayBuffer sprites;
+	for(Member &m : members)
+	{
+		if(m.sprite == NULL || m.texture != texture) continue;
+
+		B3D::SpriteRegion &r = m.sprite->GetSheet()->regions[m.sprite->GetRegion()];
+		float x = m.x, y = m.y, angle = m.angle, scaleX = m.scaleX, scaleY = m.scaleY;
+		r.Place(x, y, angle, scaleX, scaleY);
+		sprites.Push(x, y, angle, scaleX, scaleY, r.halfWidth, r.halfHeight,
+			r.u1, r.v1, r.u2, r.v2, m.color);
+	}
+
+	bucket.quads = (GLsizei)sprites.Size();
+	if(bucket.quads == 0) return;
+
+	std::vector<B3D::BVertex> verts(bucket.quads * 4);
+	B3D::TransformSprites(sprites.Arrays(), 0, sprites.Size(), verts.data());
+
+	//grow the shared index buffer if this is the biggest bucket so far
+	if(bucket.quads > indexQuads)
+	{
+		while(indexQuads < bucket.quads) indexQuads = indexQuads ? indexQuads * 2 : 1024;
+
+		std::vector<GLuint> indices(indexQuads * 6);
+		for(GLuint i = 0; i < (GLuint)indexQuads; ++i)
+		{
+			indices[i * 6] = i * 4;
+			indices[i * 6 + 1] = i * 4 + 1;
+			indices[i * 6 + 2] = i * 4 + 2;
+			indices[i * 6 + 3] = i * 4 + 2;
+			indices[i * 6 + 4] = i * 4 + 1;
+			indices[i * 6 + 5] = i * 4 + 3;
+		}
+
+		if(iboId == 0) glGenBuffers(1, &iboId);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	glBindVertexArray(bucket.vaoId);
+
+	glBindBuffer(GL_ARRAY_BUFFER, bucket.vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::BVertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
+
+	//same layout as the SpriteBatch, so we can draw with its shader
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(0)); //x,y,z
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 5)); //color
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2); //don't use channel 2
+	glEnableVertexAttribArray(3); //Color channel carries the tint
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void StaticLayer::Draw(void)
+{
+	//if the index buffer grew, every bucket's VAO has to pick up the new one
+	GLsizei previousIndexQuads = indexQuads;
+	for(GLuint texture : dirtyTextures) Rebuild(texture);
+	dirtyTextures.clear();
+
+	if(indexQuads != previousIndexQuads)
+	{
+		for(auto &item : buckets)
+		{
+			glBindVertexArray(item.second.vaoId);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	//sprites drawn before us go underneath
+	b3d->Flush();
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	GLSLProgram *prog = b3d->shader2dBatch;
+	prog->use(); //the matrices come from the frame uniform block
+
+	drawCalls = 0;
+	for(GLuint texture : textureOrder)
+	{
+		Bucket &bucket = buckets[texture];
+		if(bucket.quads == 0) continue;
+
+		b3d->tManager->BindTexture(texture);
+		glBindVertexArray(bucket.vaoId);
+		glDrawElements(GL_TRIANGLES, bucket.quads * 6, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+		drawCalls++;
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,73 @@
+#pragma once
+/*
+	Retained layer of sprites that don't move.
+
+	Add() sprites with their transforms once, then call Draw() every frame. The layer bakes its
+	sprites into one vertex buffer per texture, so drawing it costs one draw call per texture no
+	matter how many sprites it holds. Only the buffers of textures whose sprites were added,
+	changed or removed since the last Draw() are rebuilt.
+
+	Each sprite's color is baked in by Add() and Set(), along with their alpha, so to change
+	the tint of a member, change the sprite's color and Set() it again.
+
+	The layer remembers the Sprite pointers, so don't delete a sprite while it is in a layer.
+	Create layers with Blit3D::MakeStaticLayer(), after Init() has started.
+*/
+#include "Blit3D.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+class Blit3D;
+class Sprite;
+
+class StaticLayer
+{
+private:
+	class Member
+	{
+	public:
+		Sprite *sprite; //NULL if the slot is free
+		GLuint texture;
+		GLfloat x, y, angle, scaleX, scaleY;
+		GLuint color; //the sprite's tint and our alpha, packed
+	};
+
+	//one baked vertex buffer per texture
+	class Bucket
+	{
+	public:
+		GLuint vboId;
+		GLuint vaoId;
+		GLsizei quads;
+	};
+
+	std::vector<Member> members;
+	std::vector<int> freeSlots; //removed members, reused by Add()
+	std::unordered_map<GLuint, Bucket> buckets;
+	std::vector<GLuint> textureOrder; //textures in the order they were first added, which is the draw order
+	std::unordered_set<GLuint> dirtyTextures; //buckets that need rebuilding
+
+	GLuint iboId; //shared by every bucket
+	GLsizei indexQuads; //quads the index buffer has room for
+
+	Blit3D *b3d;
+
+	void Rebuild(GLuint texture);
+
+public:
+	int drawCalls; //draw calls made by the last Draw()
+
+	StaticLayer(Blit3D *blit3d);
+	~StaticLayer();
+
+	//adds a sprite with a fixed transform (angle in degrees), returns an id for Set() and Remove()
+	int Add(Sprite *sprite, float x, float y, float angle, float scaleX, float scaleY, float alpha);
+	int Add(Sprite *sprite, float x, float y);
+	void Set(int id, float x, float y, float angle, float scaleX, float scaleY, float alpha);
+	void Remove(int id);
+	void Clear(void);
+	int Size(void) { return (int)(members.size() - freeSlots.size()); }
+
+	void Draw(void); //draws the whole layer, rebuilding anything that changed
+};
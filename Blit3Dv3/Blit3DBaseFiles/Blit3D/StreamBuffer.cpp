@@ -0,0 +1,175 @@
+#include "StreamBuffer.h"
+
+extern logger oLog;
+
+StreamBuffer::StreamBuffer(GLsizeiptr bytesPerFrame, int framesInFlight)
+{
+	segmentSize = bytesPerFrame;
+	segmentCount = framesInFlight;
+	GLsizeiptr totalSize = segmentSize * segmentCount;
+
+	fences = new GLsync[segmentCount];
+	for(int i = 0; i < segmentCount; ++i) fences[i] = NULL;
+
+	head = 0;
+	currentSegment = 0;
+	reserveStart = -1;
+
+	waitTime = lastFrameWaitTime = totalWaitTime = 0.0;
+	stalls = lastFrameStalls = totalStalls = 0;
+	bytesUsed = lastFrameBytesUsed = 0;
+
+	glGenBuffers(1, &bufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+
+	mapped = NULL;
+	persistent = false;
+
+	if(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		//immutable storage that stays mapped for the life of the buffer
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, totalSize, NULL, flags);
+		mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, totalSize, flags);
+		persistent = (mapped != NULL);
+	}
+
+	if(!persistent)
+	{
+		//no persistent mapping: write into CPU memory and upload each committed range
+		oLog(Level::Warning) << "Persistent buffer mapping unavailable, StreamBuffer falls back to glBufferSubData()";
+		glDeleteBuffers(1, &bufferId);
+		glGenBuffers(1, &bufferId);
+		glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+		glBufferData(GL_ARRAY_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+		mapped = new char[totalSize];
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	oLog(Level::Info) << "Created StreamBuffer: " << segmentCount << " segments of " << segmentSize << " bytes";
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for(int i = 0; i < segmentCount; ++i)
+	{
+		if(fences[i]) glDeleteSync(fences[i]);
+	}
+	delete[] fences;
+
+	if(persistent)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	else delete[] mapped;
+
+	glDeleteBuffers(1, &bufferId);
+}
+
+void StreamBuffer::EnterSegment(int segment)
+{
+	currentSegment = segment;
+	head = segment * segmentSize;
+
+	if(fences[segment] == NULL) return;
+
+	//poll first, so we only count it as a stall if we really have to wait
+	GLenum result = glClientWaitSync(fences[segment], 0, 0);
+	if(result == GL_TIMEOUT_EXPIRED)
+	{
+		stalls++;
+		totalStalls++;
+
+		double start = glfwGetTime();
+		do
+		{
+			result = glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1 ms timeout
+		} while(result == GL_TIMEOUT_EXPIRED);
+
+		double waited = (glfwGetTime() - start) * 1000.0;
+		waitTime += waited;
+		totalWaitTime += waited;
+	}
+
+	if(result == GL_WAIT_FAILED) oLog(Level::Warning) << "StreamBuffer: glClientWaitSync() failed";
+
+	glDeleteSync(fences[segment]);
+	fences[segment] = NULL;
+}
+
+void StreamBuffer::LeaveSegment(void)
+{
+	//everything that reads from this segment has been submitted by now
+	if(fences[currentSegment]) glDeleteSync(fences[currentSegment]);
+	fences[currentSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void *StreamBuffer::Reserve(GLsizeiptr minBytes, GLsizeiptr maxBytes, GLsizeiptr alignment, GLsizeiptr &offset, GLsizeiptr &reservedBytes)
+{
+	assert(reserveStart < 0 && "StreamBuffer::Reserve() called while a reservation is still open");
+	assert(minBytes + alignment <= segmentSize && "StreamBuffer segment too small for this reservation");
+
+	if(maxBytes < minBytes) maxBytes = minBytes;
+
+	GLsizeiptr start = ((head + alignment - 1) / alignment) * alignment;
+	GLsizeiptr segmentEnd = (currentSegment + 1) * segmentSize;
+
+	if(start + minBytes > segmentEnd)
+	{
+		//not enough room left in this segment, move on to the next one
+		LeaveSegment();
+		EnterSegment((currentSegment + 1) % segmentCount);
+
+		start = ((head + alignment - 1) / alignment) * alignment;
+		segmentEnd = (currentSegment + 1) * segmentSize;
+	}
+
+	reservedBytes = segmentEnd - start;
+	if(reservedBytes > maxBytes) reservedBytes = maxBytes;
+
+	offset = start;
+	reserveStart = start;
+	return mapped + start;
+}
+
+void StreamBuffer::Commit(GLsizeiptr usedBytes)
+{
+	assert(reserveStart >= 0 && "StreamBuffer::Commit() called without a reservation");
+
+	if(!persistent && usedBytes > 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+		glBufferSubData(GL_ARRAY_BUFFER, reserveStart, usedBytes, mapped + reserveStart);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	head = reserveStart + usedBytes;
+	bytesUsed += usedBytes;
+	reserveStart = -1;
+}
+
+void StreamBuffer::EndFrame(void)
+{
+	assert(reserveStart < 0 && "StreamBuffer::EndFrame() called while a reservation is still open");
+
+	//fence what we drew this frame, and start next frame on a fresh segment
+	LeaveSegment();
+	EnterSegment((currentSegment + 1) % segmentCount);
+
+	if(stalls > 0 && stalls == totalStalls)
+	{
+		//only warn the first time, the stats keep counting
+		oLog(Level::Warning) << "StreamBuffer waited " << waitTime << " ms on the GPU, the ring is too small: "
+			<< segmentCount << " segments of " << segmentSize << " bytes";
+	}
+
+	lastFrameWaitTime = waitTime;
+	lastFrameStalls = stalls;
+	lastFrameBytesUsed = bytesUsed;
+	waitTime = 0.0;
+	stalls = 0;
+	bytesUsed = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+/*
+	Streaming vertex memory for dynamic geometry.
+
+	One big buffer, created with glBufferStorage() and persistently mapped (coherent), split into
+	a ring of per-frame segments. Every frame starts writing at the beginning of a new segment;
+	when a segment is left, or the frame ends, a fence is placed behind the draws that read from
+	it. Before a segment is written to again we wait on its fence with glClientWaitSync(), so
+	the CPU never overwrites data the GPU hasn't drawn yet, and the driver never has to do an
+	implicit sync on our behalf.
+
+	Usage: Reserve() some memory, write your vertices through the returned pointer, Commit() the
+	bytes you actually used, then issue the draw calls that read them. Only one reservation can
+	be open at a time, so always Commit() and draw before reserving again.
+
+	If the time spent waiting on fences (waitTime/stalls stats) is above zero, the ring is too
+	small for the amount of geometry you stream: raise the segment size or the segment count
+	with Blit3D::SetStreamBufferSize() before calling Run().
+*/
+#include "Blit3D.h"
+
+class StreamBuffer
+{
+private:
+	GLuint bufferId;
+	char *mapped; //persistently mapped memory, or CPU staging memory if persistent mapping isn't available
+	bool persistent;
+
+	GLsizeiptr segmentSize; //bytes per frame segment
+	int segmentCount; //frames in flight
+	GLsync *fences; //one per segment, NULL if the GPU isn't using the segment
+
+	GLsizeiptr head; //next free byte
+	int currentSegment;
+	GLsizeiptr reserveStart; //start of the open reservation, -1 if none
+
+	void EnterSegment(int segment); //waits until the GPU is done with the segment
+	void LeaveSegment(void); //fences the current segment
+
+public:
+	//stats, for tuning the ring size
+	double waitTime; //milliseconds spent waiting on fences so far this frame
+	int stalls; //fences that weren't signalled yet when we needed their segment, this frame
+	GLsizeiptr bytesUsed; //bytes committed so far this frame
+	double lastFrameWaitTime;
+	int lastFrameStalls;
+	GLsizeiptr lastFrameBytesUsed;
+	double totalWaitTime; //milliseconds spent waiting since the buffer was created
+	int totalStalls;
+
+	StreamBuffer(GLsizeiptr bytesPerFrame, int framesInFlight);
+	~StreamBuffer();
+
+	//Returns a pointer to at least minBytes (and up to maxBytes) of write-only memory, starting
+	//at a multiple of alignment bytes from the start of the buffer. offset is set to that
+	//byte offset, reservedBytes to how much memory you actually got. minBytes must fit in a segment.
+	void *Reserve(GLsizeiptr minBytes, GLsizeiptr maxBytes, GLsizeiptr alignment, GLsizeiptr &offset, GLsizeiptr &reservedBytes);
+	void Commit(GLsizeiptr usedBytes); //closes the open reservation, keeping usedBytes of it
+	void EndFrame(void); //fences this frame's memory and moves on to the next segment
+	GLuint GetBuffer(void) { return bufferId; }
+	GLsizeiptr GetSegmentSize(void) { return segmentSize; }
+};
@@ -0,0 +1,278 @@
+#include "TextureAtlas.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <chrono>
+
+extern logger oLog;
+
+TextureAtlas::TextureAtlas(Blit3D *blit3d, std::string atlasName, int width, int height, int paddingPixels, int extrudePixels)
+{
+	assert(width > 0 && height > 0 && paddingPixels >= 0 && extrudePixels >= 0);
+
+	b3d = blit3d;
+	name = atlasName;
+	pageWidth = width;
+	pageHeight = height;
+	padding = paddingPixels;
+	extrude = extrudePixels;
+	useMipMaps = false;
+	pixelate = true;
+	built = false;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	for(Page &page : pages) b3d->tManager->FreeTexture(page.texture);
+	for(Entry &entry : entries) if(entry.pixels) stbi_image_free(entry.pixels);
+}
+
+void TextureAtlas::Add(std::string filename)
+{
+	assert(!built && "TextureAtlas::Add() after Build()");
+	if(entryLookup.find(filename) != entryLookup.end()) return;
+
+	Entry entry;
+	entry.filename = filename;
+	entry.pixels = NULL;
+	entry.width = entry.height = 0;
+	entry.region.x = entry.region.y = entry.region.width = entry.region.height = 0.f;
+	entry.region.page = -1;
+
+	entryLookup[filename] = (int)entries.size();
+	entries.push_back(entry);
+}
+
+//skyline bottom-left: the lowest spot (nearest the top of the page, as y counts down) where the rect fits
+bool TextureAtlas::FindSpot(Page &page, int width, int height, int &bestNode, int &bestX, int &bestY)
+{
+	int bestBottom = INT_MAX;
+	int bestWidth = INT_MAX;
+	bestNode = -1;
+
+	for(size_t i = 0; i < page.skyline.size(); ++i)
+	{
+		int x = page.skyline[i].x;
+		if(x + width > pageWidth) break;
+
+		//the rect rests on the highest segment under it
+		int y = 0;
+		int remaining = width;
+		for(size_t j = i; remaining > 0; ++j)
+		{
+			y = std::max(y, page.skyline[j].y);
+			remaining -= page.skyline[j].width;
+		}
+		if(y + height > pageHeight) continue;
+
+		//lowest bottom edge wins, then the narrowest segment, which leaves the fewest gaps
+		if(y + height < bestBottom || (y + height == bestBottom && page.skyline[i].width < bestWidth))
+		{
+			bestBottom = y + height;
+			bestWidth = page.skyline[i].width;
+			bestNode = (int)i;
+			bestX = x;
+			bestY = y;
+		}
+	}
+
+	return bestNode >= 0;
+}
+
+void TextureAtlas::Place(Page &page, int node, int x, int y, int width, int height)
+{
+	SkylineNode top;
+	top.x = x;
+	top.y = y + height;
+	top.width = width;
+	page.skyline.insert(page.skyline.begin() + node, top);
+
+	//trim the segments the new one now covers
+	for(size_t i = node + 1; i < page.skyline.size();)
+	{
+		SkylineNode &previous = page.skyline[i - 1];
+		SkylineNode &current = page.skyline[i];
+		int overlap = previous.x + previous.width - current.x;
+		if(overlap <= 0) break;
+
+		current.x += overlap;
+		current.width -= overlap;
+		if(current.width > 0) break;
+		page.skyline.erase(page.skyline.begin() + i);
+	}
+
+	//merge neighbours at the same height
+	for(size_t i = 0; i + 1 < page.skyline.size();)
+	{
+		if(page.skyline[i].y == page.skyline[i + 1].y)
+		{
+			page.skyline[i].width += page.skyline[i + 1].width;
+			page.skyline.erase(page.skyline.begin() + i + 1);
+		}
+		else ++i;
+	}
+}
+
+void TextureAtlas::Blit(Page &page, const Entry &entry, int cellX, int cellY)
+{
+	int imageX = cellX + extrude;
+	int imageY = cellY + extrude;
+	size_t rowBytes = (size_t)entry.width * 4;
+
+	//page and image are both stored bottom row first, while our rects count from the top
+	for(int ty = imageY - extrude; ty < imageY + entry.height + extrude; ++ty)
+	{
+		int sy = std::min(std::max(ty - imageY, 0), entry.height - 1);
+		const BYTE *source = entry.pixels + (size_t)(entry.height - 1 - sy) * rowBytes;
+		BYTE *dest = page.pixels.data() + ((size_t)(pageHeight - 1 - ty) * pageWidth + imageX) * 4;
+
+		memcpy(dest, source, rowBytes);
+		for(int e = 1; e <= extrude; ++e)
+		{
+			memcpy(dest - e * 4, source, 4);
+			memcpy(dest + rowBytes + (e - 1) * 4, source + rowBytes - 4, 4);
+		}
+	}
+}
+
+bool TextureAtlas::Build(void)
+{
+	assert(!built && "TextureAtlas::Build() called twice");
+	built = true;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//decode everything in parallel, nothing here touches GL
+	b3d->threadPool->ParallelFor(entries.size(), [this](size_t begin, size_t end, int /*worker*/)
+	{
+		for(size_t i = begin; i < end; ++i)
+		{
+			int components = 0;
+			entries[i].pixels = stbi_load(entries[i].filename.c_str(), &entries[i].width, &entries[i].height, &components, 4);
+		}
+	});
+
+	//tallest first packs a skyline best
+	std::vector<int> order;
+	order.reserve(entries.size());
+	for(size_t i = 0; i < entries.size(); ++i) order.push_back((int)i);
+	std::sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		if(entries[a].height != entries[b].height) return entries[a].height > entries[b].height;
+		return entries[a].width > entries[b].width;
+	});
+
+	bool ok = true;
+	for(int index : order)
+	{
+		Entry &entry = entries[index];
+		if(entry.pixels == NULL)
+		{
+			oLog(Level::Severe) << "Atlas " << name << ": can't load image " << entry.filename;
+			ok = false;
+			continue;
+		}
+
+		int cellWidth = entry.width + 2 * extrude + padding;
+		int cellHeight = entry.height + 2 * extrude + padding;
+		if(cellWidth - padding > pageWidth || cellHeight - padding > pageHeight)
+		{
+			oLog(Level::Severe) << "Atlas " << name << ": " << entry.filename << " (" << entry.width << "x" << entry.height
+				<< ") doesn't fit on a " << pageWidth << "x" << pageHeight << " page";
+			ok = false;
+			continue;
+		}
+		//the padding isn't needed past the edge of the page
+		cellWidth = std::min(cellWidth, pageWidth);
+		cellHeight = std::min(cellHeight, pageHeight);
+
+		//first page with room, or a new one
+		int pageIndex, node = -1, x = 0, y = 0;
+		for(pageIndex = 0; pageIndex < (int)pages.size(); ++pageIndex)
+		{
+			if(FindSpot(pages[pageIndex], cellWidth, cellHeight, node, x, y)) break;
+		}
+		if(pageIndex == (int)pages.size())
+		{
+			Page page;
+			SkylineNode floor;
+			floor.x = floor.y = 0;
+			floor.width = pageWidth;
+			page.skyline.push_back(floor);
+			page.pixels.assign((size_t)pageWidth * pageHeight * 4, 0);
+			page.images = 0;
+			page.usedPixels = 0;
+			pages.push_back(page);
+
+			FindSpot(pages.back(), cellWidth, cellHeight, node, x, y);
+		}
+
+		Page &page = pages[pageIndex];
+		Place(page, node, x, y, cellWidth, cellHeight);
+		Blit(page, entry, x, y);
+		page.images++;
+		page.usedPixels += (long long)entry.width * entry.height;
+
+		entry.region.page = pageIndex;
+		entry.region.x = (GLfloat)(x + extrude);
+		entry.region.y = (GLfloat)(y + extrude);
+		entry.region.width = (GLfloat)entry.width;
+		entry.region.height = (GLfloat)entry.height;
+
+		stbi_image_free(entry.pixels);
+		entry.pixels = NULL;
+	}
+
+	//one upload per page
+	for(size_t i = 0; i < pages.size(); ++i)
+	{
+		std::string pageName = name + "#" + std::to_string(i);
+		pages[i].texture = b3d->tManager->CreateTexture(pageName, pages[i].pixels.data(), pageWidth, pageHeight, useMipMaps, GL_CLAMP_TO_EDGE, pixelate);
+		std::vector<BYTE>().swap(pages[i].pixels);
+	}
+	for(Entry &entry : entries)
+	{
+		if(entry.region.page >= 0)
+		{
+			entry.region.texture = name + "#" + std::to_string(entry.region.page);
+			entry.region.textureHandle = pages[entry.region.page].texture;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	oLog(Level::Info) << "Built atlas " << name << ": " << entries.size() << " images on " << pages.size() << " pages in " << elapsed.count() << " ms";
+	LogOccupancy();
+
+	return ok;
+}
+
+const B3D::AtlasRegion *TextureAtlas::Find(const std::string &filename)
+{
+	auto itr = entryLookup.find(filename);
+	if(itr == entryLookup.end()) return NULL;
+	return &entries[itr->second].region;
+}
+
+float TextureAtlas::Occupancy(int page)
+{
+	assert(page >= 0 && page < (int)pages.size());
+	return (float)((double)pages[page].usedPixels / ((double)pageWidth * pageHeight));
+}
+
+void TextureAtlas::LogOccupancy(void)
+{
+	long long used = 0;
+	for(size_t i = 0; i < pages.size(); ++i)
+	{
+		used += pages[i].usedPixels;
+		oLog(Level::Info) << "Atlas " << name << " page " << i << ": " << pages[i].images << " images, "
+			<< Occupancy((int)i) * 100.f << "% occupied";
+	}
+
+	if(!pages.empty())
+	{
+		oLog(Level::Info) << "Atlas " << name << " overall: " << 100.0 * used / ((double)pageWidth * pageHeight * pages.size())
+			<< "% of " << pages.size() << " " << pageWidth << "x" << pageHeight << " pages";
+	}
+}
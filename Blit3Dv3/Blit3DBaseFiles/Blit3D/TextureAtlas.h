@@ -0,0 +1,83 @@
+#pragma once
+/*
+	Runtime texture atlas.
+
+	Packs lots of small images into a few big textures ("pages"), so sprites cut from them share a
+	texture and batch together instead of each one costing a texture bind. Add() the image files,
+	then Build() once: the images are decoded in parallel on blit3D->threadPool, packed tallest first
+	with a skyline packer, and each page is uploaded in one go.
+
+	Padding leaves empty pixels between images. Extrusion repeats each image's edge pixels outward,
+	so filtering at the edge of a sprite samples its own border instead of a neighbour.
+
+	Each image gets a B3D::AtlasRegion (see AtlasLoader.h): the page's texture name plus the pixel rect
+	on it. That is exactly what MakeSprite(), MakeAnimationClip(), MakeParticleEmitter() etc. already
+	take, or pass the region straight to Blit3D::MakeSprite(region).
+
+	Make atlases with Blit3D::MakeTextureAtlas() and delete them with DeleteTextureAtlas(). Pages are
+	reference counted by the TextureManager, so sprites keep working after their atlas is deleted.
+*/
+#include "Blit3D.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+class Blit3D;
+
+class TextureAtlas
+{
+private:
+	class SkylineNode
+	{
+	public:
+		int x, y, width; //a horizontal segment of the skyline, y counts down from the top of the page
+	};
+
+	class Page
+	{
+	public:
+		std::vector<SkylineNode> skyline;
+		std::vector<BYTE> pixels; //only while building
+		TextureHandle texture; //once built
+		int images;
+		long long usedPixels; //image pixels, not counting padding and extrusion
+	};
+
+	class Entry
+	{
+	public:
+		std::string filename;
+		BYTE *pixels; //decoded, bottom row first; only while building
+		int width, height;
+		B3D::AtlasRegion region;
+	};
+
+	Blit3D *b3d;
+	std::vector<Page> pages;
+	std::vector<Entry> entries;
+	std::unordered_map<std::string, int> entryLookup;
+	bool built;
+
+	bool FindSpot(Page &page, int width, int height, int &bestNode, int &bestX, int &bestY);
+	void Place(Page &page, int node, int x, int y, int width, int height);
+	void Blit(Page &page, const Entry &entry, int cellX, int cellY); //the image and its extruded border
+
+public:
+	std::string name; //pages are called name#0, name#1...
+	int pageWidth, pageHeight;
+	int padding; //empty pixels between images
+	int extrude; //edge pixels repeated around each image
+	bool useMipMaps, pixelate; //passed on to the page textures
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that
+	TextureAtlas(Blit3D *blit3d, std::string atlasName, int width, int height, int paddingPixels, int extrudePixels);
+	~TextureAtlas(); //drops our reference to the pages
+
+	void Add(std::string filename); //before Build(); adding the same file twice is harmless
+	bool Build(void); //false if any image couldn't be loaded or didn't fit on a page
+
+	const B3D::AtlasRegion *Find(const std::string &filename); //NULL if it wasn't added
+	int PageCount(void) { return (int)pages.size(); }
+	float Occupancy(int page); //fraction of the page covered by images
+	void LogOccupancy(void);
+};
@@ -0,0 +1,273 @@
+#include "TextureCache.h"
+#include "Logger.h"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX //we want std::max
+	#include <windows.h>
+	#include <direct.h>
+#else
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+extern logger oLog;
+
+#define TEXTURE_CACHE_VERSION 1
+
+//start of every cache file, the pixels follow
+class TextureCacheHeader
+{
+public:
+	char magic[4]; //"B3TC"
+	uint32_t version;
+	uint32_t width, height, levels;
+	uint32_t reserved;
+	uint64_t key; //must match the file name, guards against a renamed or truncated file
+};
+
+static size_t LevelBytes(int width, int height, int level)
+{
+	size_t w = std::max(1, width >> level);
+	size_t h = std::max(1, height >> level);
+	return w * h * 4;
+}
+
+//FNV-1a, 64 bit
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t length)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for(size_t i = 0; i < length; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+TextureCacheEntry::TextureCacheEntry()
+{
+	data = NULL;
+	size = 0;
+	width = height = levels = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fd = -1;
+#endif
+}
+
+TextureCacheEntry::~TextureCacheEntry()
+{
+#ifdef _WIN32
+	if(data) UnmapViewOfFile(data);
+	if(mappingHandle) CloseHandle(mappingHandle);
+	if(fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#else
+	if(data) munmap((void *)data, size);
+	if(fd >= 0) close(fd);
+#endif
+}
+
+const unsigned char *TextureCacheEntry::Level(int level, int &levelWidth, int &levelHeight) const
+{
+	assert(level >= 0 && level < levels);
+
+	const unsigned char *pixels = data + sizeof(TextureCacheHeader);
+	for(int i = 0; i < level; ++i) pixels += LevelBytes(width, height, i);
+
+	levelWidth = std::max(1, width >> level);
+	levelHeight = std::max(1, height >> level);
+	return pixels;
+}
+
+size_t TextureCacheEntry::PixelBytes(void) const
+{
+	return size - sizeof(TextureCacheHeader);
+}
+
+TextureCache::TextureCache()
+{
+	hits = 0;
+	misses = 0;
+	bytesSaved = 0;
+}
+
+void TextureCache::SetDirectory(std::string dir)
+{
+	directory = dir;
+	if(directory.empty())
+	{
+		oLog(Level::Info) << "Texture cache off";
+		return;
+	}
+
+	if(directory.back() != '/' && directory.back() != '\\') directory += '/';
+
+#ifdef _WIN32
+	_mkdir(directory.c_str()); //fails harmlessly if it's already there
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	oLog(Level::Info) << "Texture cache directory: " << directory;
+}
+
+std::string TextureCache::PathFor(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.b3dtex", (unsigned long long)key);
+	return directory + name;
+}
+
+bool TextureCache::ReadSource(const std::string &filename, std::vector<unsigned char> &bytes, uint64_t &key)
+{
+	struct stat info;
+	if(stat(filename.c_str(), &info) != 0) return false;
+
+	std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+	if(!ifs.is_open()) return false;
+
+	bytes.resize((size_t)info.st_size);
+	if(!bytes.empty() && !ifs.read((char *)bytes.data(), bytes.size())) return false;
+
+	uint64_t size = (uint64_t)info.st_size;
+	uint64_t modified = (uint64_t)info.st_mtime;
+
+	key = 14695981039346656037ULL;
+	key = HashBytes(key, filename.data(), filename.size());
+	key = HashBytes(key, &size, sizeof(size));
+	key = HashBytes(key, &modified, sizeof(modified));
+	key = HashBytes(key, bytes.data(), bytes.size());
+	return true;
+}
+
+TextureCacheEntry *TextureCache::Open(const std::string &filename, uint64_t key)
+{
+	std::string path = PathFor(key);
+	TextureCacheEntry *entry = new TextureCacheEntry();
+
+#ifdef _WIN32
+	entry->fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(entry->fileHandle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(entry->fileHandle, &fileSize);
+		entry->size = (size_t)fileSize.QuadPart;
+		if(entry->size > 0) entry->mappingHandle = CreateFileMappingA(entry->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(entry->mappingHandle) entry->data = (const unsigned char *)MapViewOfFile(entry->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	entry->fd = open(path.c_str(), O_RDONLY);
+	struct stat info;
+	if(entry->fd >= 0 && fstat(entry->fd, &info) == 0 && info.st_size > 0)
+	{
+		entry->size = (size_t)info.st_size;
+		void *mapped = mmap(NULL, entry->size, PROT_READ, MAP_PRIVATE, entry->fd, 0);
+		if(mapped != MAP_FAILED) entry->data = (const unsigned char *)mapped;
+	}
+#endif
+
+	bool valid = false;
+	if(entry->data && entry->size >= sizeof(TextureCacheHeader))
+	{
+		TextureCacheHeader header;
+		memcpy(&header, entry->data, sizeof(header));
+
+		size_t expected = sizeof(TextureCacheHeader);
+		for(uint32_t i = 0; i < header.levels; ++i) expected += LevelBytes(header.width, header.height, i);
+
+		valid = memcmp(header.magic, "B3TC", 4) == 0 && header.version == TEXTURE_CACHE_VERSION && header.key == key
+			&& header.width > 0 && header.height > 0 && header.levels > 0 && expected == entry->size;
+
+		if(valid)
+		{
+			entry->width = header.width;
+			entry->height = header.height;
+			entry->levels = header.levels;
+		}
+		else oLog(Level::Warning) << "Texture cache file " << path << " is damaged or out of date, ignoring it";
+	}
+
+	if(!valid)
+	{
+		delete entry;
+		misses++;
+		oLog(Level::Info) << "Texture cache miss: " << filename;
+		return NULL;
+	}
+
+	hits++;
+	bytesSaved += entry->PixelBytes();
+	oLog(Level::Info) << "Texture cache hit: " << filename << " (" << entry->width << "x" << entry->height << ", "
+		<< entry->levels << " levels, " << entry->PixelBytes() << " bytes not decoded)";
+	return entry;
+}
+
+bool TextureCache::Store(const std::string &filename, uint64_t key, int width, int height, const std::vector<std::vector<unsigned char>> &levels)
+{
+	std::string path = PathFor(key);
+	std::string tempPath = path + ".tmp";
+
+	TextureCacheHeader header;
+	memcpy(header.magic, "B3TC", 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.levels = (uint32_t)levels.size();
+	header.reserved = 0;
+	header.key = key;
+
+	{
+		std::ofstream ofs(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!ofs.is_open())
+		{
+			oLog(Level::Warning) << "Can't write texture cache file " << tempPath;
+			return false;
+		}
+
+		ofs.write((const char *)&header, sizeof(header));
+		for(size_t i = 0; i < levels.size(); ++i)
+		{
+			assert(levels[i].size() == LevelBytes(width, height, (int)i));
+			ofs.write((const char *)levels[i].data(), levels[i].size());
+		}
+
+		if(!ofs)
+		{
+			oLog(Level::Warning) << "Failed writing texture cache file " << tempPath;
+			ofs.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+	if(!renamed)
+	{
+		oLog(Level::Warning) << "Can't rename texture cache file " << tempPath;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	oLog(Level::Info) << "Texture cache stored: " << filename << " (" << levels.size() << " levels)";
+	return true;
+}
+
+void TextureCache::LogStats(void)
+{
+	if(!Enabled()) return;
+	oLog(Level::Info) << "Texture cache: " << hits.load() << " hits, " << misses.load() << " misses, " << bytesSaved.load() << " decoded bytes saved";
+}
@@ -0,0 +1,71 @@
+#pragma once
+/*
+	On-disk cache of decoded textures.
+
+	Decoding PNGs is the slow part of loading a texture, so once an image has been decoded its RGBA8
+	pixels (and its mip levels, if it was mipmapped by LoadTexture()) are written to a file in the cache
+	directory. Async loads write the file from the worker, level 0 only, so the GL thread never waits on it.
+	The next time that image is loaded the cache file is memory-mapped and handed straight to OpenGL.
+
+	Cache files are named after a key made from the source path, its size, its modification time and
+	a hash of its contents, so editing an image just makes a new entry. Old entries are never removed,
+	delete the directory to clear the cache.
+
+	Off by default; TextureManager::SetCacheDirectory() turns it on. Everything here is file I/O only,
+	no OpenGL, so the async loaders call it from worker threads.
+*/
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+//one cache file, mapped read-only: RGBA8 pixels for each mip level, largest first
+class TextureCacheEntry
+{
+private:
+	friend class TextureCache;
+
+	const unsigned char *data; //the whole mapped file
+	size_t size;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fd;
+#endif
+
+	TextureCacheEntry();
+
+public:
+	int width, height, levels;
+
+	~TextureCacheEntry(); //unmaps the file
+
+	const unsigned char *Level(int level, int &levelWidth, int &levelHeight) const;
+	size_t PixelBytes(void) const; //all levels
+};
+
+class TextureCache
+{
+private:
+	std::string directory; //empty when the cache is off
+
+	std::string PathFor(uint64_t key);
+
+public:
+	std::atomic<unsigned long long> hits, misses, bytesSaved; //bytesSaved counts decoded pixels we didn't have to decode
+
+	TextureCache();
+
+	void SetDirectory(std::string dir); //creates it if needed, "" turns the cache off
+	bool Enabled(void) { return !directory.empty(); }
+
+	//reads the whole source file and works out its cache key from the path, size, modification time and contents
+	bool ReadSource(const std::string &filename, std::vector<unsigned char> &bytes, uint64_t &key);
+	//maps the cache file for key; NULL on a miss. Counts and logs hits and misses
+	TextureCacheEntry *Open(const std::string &filename, uint64_t key);
+	//writes the levels (RGBA8, largest first) to a temporary file and renames it, so a reader never maps half a file
+	bool Store(const std::string &filename, uint64_t key, int width, int height, const std::vector<std::vector<unsigned char>> &levels);
+
+	void LogStats(void);
+};
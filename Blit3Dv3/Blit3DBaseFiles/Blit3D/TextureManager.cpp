@@ -1,5 +1,6 @@
 #include "TextureManager.h"
 #include <iostream>
+#include <chrono>
 #include "Logger.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,9 +13,17 @@ TextureManager::TextureManager(void)
 {
 	
 	for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i) currentId[i] = -1;
+	glThread = std::this_thread::get_id();
 
 	texturePath = "";
 
+	loaderPool = NULL;
+	decodesInFlight = 0;
+	textureBudget = 0;
+	residentBytes = idleBytes = evictedBytes = 0;
+	loadHits = loadMisses = revivals = evictions = 0;
+	uploadBudgetMs = 2.0;
+
 	//try for nicest mipmap generation
 	glHint(GL_GENERATE_MIPMAP_HINT, GL_NICEST );
 
@@ -26,15 +35,31 @@ TextureManager::TextureManager(void)
 
 TextureManager::~TextureManager(void)
 {
-	//free all our textures
-	for(itor = textures.begin(); itor != textures.end(); itor++)
-	{		
-		glDeleteTextures( 1, &(*itor->second).texId); //free the texture memory used by OpenGL
-		delete (itor)->second; //free the instance of a tex struct
+	//workers still decoding write into our queue, so let them finish; after that every load is in decoded
+	{
+		std::unique_lock<std::mutex> lock(asyncMutex);
+		decodeFinished.wait(lock, [this] { return decodesInFlight == 0; });
 	}
 
+	for(AsyncTextureLoad *load : decoded)
+	{
+		if(load->bits) stbi_image_free(load->bits);
+		if(load->cached) delete load->cached;
+		if(load->compressed) delete load->compressed;
+		delete load;
+	}
+	decoded.clear();
+
+	LogResidency();
+
+	//free all our textures
+	texturePool.ForEach([](tex *t) { glDeleteTextures(1, &t->texId); }); //free the texture memory used by OpenGL
+	if(!deadIds.empty()) glDeleteTextures((GLsizei)deadIds.size(), deadIds.data());
+
+	texturePool.Clear(); //free the tex structs
 	textures.clear(); //free the map
 
+	cache.LogStats();
 	oLog(Level::Info) << "TextureManager destroyed";
 }
 
@@ -44,17 +69,162 @@ void TextureManager::SetTexturePath(std::string path)
 	oLog(Level::Info) << "Texture Path set to: " << path;
 }
 
-GLuint TextureManager::LoadTexture(std::string filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+void TextureManager::SetCacheDirectory(std::string directory)
+{
+	cache.SetDirectory(directory);
+}
+
+//RGBA8, plus a third for the mip chain
+static size_t EstimateBytes(int width, int height, bool useMipMaps)
+{
+	size_t bytes = (size_t)width * height * 4;
+	return useMipMaps ? bytes + bytes / 3 : bytes;
+}
+
+BYTE *TextureManager::DecodeImage(const std::string &filename, int &width, int &height, TextureCacheEntry *&cached, uint64_t &cacheKey, bool &haveKey)
+{
+	int components = 0;
+	cached = NULL;
+	haveKey = false;
+
+	if(!cache.Enabled()) return stbi_load(filename.c_str(), &width, &height, &components, 4);
+
+	//we need the file's bytes for the key anyway, so a miss decodes from memory instead of reading it again
+	std::vector<unsigned char> source;
+	if(!cache.ReadSource(filename, source, cacheKey)) return NULL;
+	haveKey = true;
+
+	cached = cache.Open(filename, cacheKey);
+	if(cached)
+	{
+		width = cached->width;
+		height = cached->height;
+		return NULL;
+	}
+
+	return stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &components, 4);
+}
+
+void TextureManager::UploadCached(TextureCacheEntry *cached, bool useMipMaps)
+{
+	int levels = useMipMaps ? cached->levels : 1;
+	for(int level = 0; level < levels; ++level)
+	{
+		int levelWidth, levelHeight;
+		const unsigned char *pixels = cached->Level(level, levelWidth, levelHeight);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	//cached without mips, but now we want them
+	if(useMipMaps && cached->levels == 1) glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+bool TextureManager::UploadCompressed(const std::string &filename, const B3D::CompressedImage &image, bool useMipMaps, bool &mipmapped, size_t &bytes)
+{
+	bool native = B3D::CompressedFormatSupported(image.format);
+	std::vector<unsigned char> rgba;
+
+	if(!native && !B3D::DecompressLevel(image, 0, rgba))
+	{
+		oLog(Level::Severe) << filename << ": this driver can't sample " << B3D::BlockFormatName(image.format) << " textures and there is no CPU decoder for it";
+		return false;
+	}
+
+	//without mips wanted, the extra levels would only take up memory
+	int levels = useMipMaps ? (int)image.levels.size() : 1;
+	bytes = 0;
+	for(int level = 0; level < levels; ++level)
+	{
+		const B3D::CompressedLevel &info = image.levels[level];
+		if(native)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, B3D::CompressedGLFormat(image.format), info.width, info.height, 0,
+				(GLsizei)info.size, image.data.data() + info.offset);
+			bytes += info.size;
+		}
+		else
+		{
+			if(level > 0) B3D::DecompressLevel(image, level, rgba);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.width, info.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+			bytes += rgba.size();
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	mipmapped = useMipMaps;
+	if(useMipMaps && levels == 1)
+	{
+		if(native)
+		{
+			//GL won't generate mips for a compressed format
+			oLog(Level::Warning) << filename << " has no mip levels stored, so it is filtered without mipmaps";
+			mipmapped = false;
+		}
+		else
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			bytes += bytes / 3;
+		}
+	}
+
+	size_t rgbaBytes = 0;
+	for(int level = 0; level < levels; ++level) rgbaBytes += (size_t)image.levels[level].width * image.levels[level].height * 4;
+	oLog(Level::Info) << "Loaded " << filename << ": " << B3D::BlockFormatName(image.format) << (native ? "" : " decoded on the CPU") << ", "
+		<< image.width << "x" << image.height << ", " << levels << " levels, " << bytes << " bytes (" << rgbaBytes << " as RGBA8)";
+	return true;
+}
+
+void TextureManager::StoreInCache(const std::string &filename, uint64_t cacheKey, BYTE *bits, int width, int height, bool useMipMaps)
 {
-	itor = textures.find(filename); //lookup this texture in our std::map
+	std::vector<std::vector<unsigned char>> levels(1);
+	levels[0].assign(bits, bits + (size_t)width * height * 4);
+
+	if(useMipMaps)
+	{
+		//read back what glGenerateMipmap() made, so a cache hit can skip that too
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		for(int level = 1; (width >> (level - 1)) > 1 || (height >> (level - 1)) > 1; ++level)
+		{
+			int levelWidth = std::max(1, width >> level);
+			int levelHeight = std::max(1, height >> level);
+			levels.push_back(std::vector<unsigned char>((size_t)levelWidth * levelHeight * 4));
+			glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, levels.back().data());
+		}
+	}
+
+	cache.Store(filename, cacheKey, width, height, levels);
+}
+
+GLuint TextureManager::LoadTexture(const std::string &filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = LoadInternal(filename, useMipMaps, texture_unit, wrapflag, pixelate);
+	return t ? t->texId : 0;
+}
+
+TextureHandle TextureManager::Load(const std::string &filename, bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	return texturePool.HandleOf(LoadInternal(filename, useMipMaps, GL_TEXTURE0, wrapflag, pixelate));
+}
+
+tex *TextureManager::LoadInternal(const std::string &filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	auto itor = textures.find(filename); //lookup this texture in our std::map
 
 	if(itor == textures.end())
 	{
 		//we didn't find that texture name, so it is a new texture
-		tex *newtex = new tex;
+		tex *newtex = texturePool.Create();
+		newtex->name = filename;
+		newtex->fromFile = true;
+		loadMisses++;
 
 		newtex->refcount = 1;
 		newtex->unload = true; //currently setting all textures to unload when refcount = 0;
+		newtex->pending = NULL;
 
 		//add the path to the file
 		std::string fullpath;
@@ -63,20 +233,61 @@ GLuint TextureManager::LoadTexture(std::string filename, bool useMipMaps, GLuint
 
 		//pointer to the image data
 		BYTE* bits(0);
-		//image width and height, and #of components (1= gray scale, 4 = rgba)
-		int width(0), height(0), components(0);
+		//image width and height
+		int width(0), height(0);
 		//OpenGL's image ID to map to
 		GLuint gl_texID;
+		//decoded image from the disk cache, if it has one
+		TextureCacheEntry *cached = NULL;
+		uint64_t cacheKey = 0;
+		bool haveKey = false;
+
+		if(B3D::IsCompressedTextureFile(filename))
+		{
+			//already in a GPU format: no stb, no cache, and the file's own mips
+			B3D::CompressedImage image;
+			bool mipmapped = false;
+			size_t bytes = 0;
+			if(!B3D::ReadCompressedTexture(filename, image))
+			{
+				texturePool.Destroy(newtex);
+				goto ERROR_HANDLER;
+			}
+
+			glGenTextures(1, &gl_texID);
+			glActiveTexture(texture_unit);
+			glBindTexture(GL_TEXTURE_2D, gl_texID);
+			if(!UploadCompressed(filename, image, useMipMaps, mipmapped, bytes))
+			{
+				glDeleteTextures(1, &gl_texID);
+				currentId[texture_unit - GL_TEXTURE0] = 0;
+				texturePool.Destroy(newtex);
+				goto ERROR_HANDLER;
+			}
+
+			newtex->texId = gl_texID;
+			newtex->width = image.width;
+			newtex->height = image.height;
+			textures[filename] = newtex;
+			currentId[texture_unit - GL_TEXTURE0] = gl_texID;
+			SetResidentBytes(newtex, bytes);
+
+			SetTextureParameters(mipmapped, wrapflag, pixelate);
+			TrimToBudget();
+			return newtex;
+		}
 
 		//retrieve the image data, currently force to RGBA (4 components)
-		bits = stbi_load(filename.c_str(), &width, &height, &components, 4);
+		bits = DecodeImage(filename, width, height, cached, cacheKey, haveKey);
 		
 		//if somehow one of these failed (they shouldn't), return failure
-		if((bits == 0) || (width == 0) || (height == 0))
+		if(cached == NULL && ((bits == 0) || (width == 0) || (height == 0)))
 		{
 			if(bits == 0) oLog(Level::Severe) << "bits = 0";
 			if(width == 0) oLog(Level::Severe) << "width = 0";
 			if(height == 0) oLog(Level::Severe) << "height = 0";
+			if(bits) stbi_image_free(bits);
+			texturePool.Destroy(newtex);
 			goto ERROR_HANDLER;
 		}
 		
@@ -93,100 +304,234 @@ GLuint TextureManager::LoadTexture(std::string filename, bool useMipMaps, GLuint
 		GLenum image_format = GL_RGBA;
 		GLint internal_format = GL_RGBA;
 		GLint level = 0;
-		//store the texture data for OpenGL use
-		glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height,
-			0, image_format, GL_UNSIGNED_BYTE, bits);
-
-		//swizzle colors - not needed for stb_image
-		//GLint swizzleMask[] = { GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA };
-		//glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
-
-		if (useMipMaps)
+		if (cached)
 		{
-			glGenerateMipmap(GL_TEXTURE_2D);
+			//mip levels and all, straight from the mapped file
+			UploadCached(cached, useMipMaps);
+			delete cached;
 		}
+		else
+		{
+			//store the texture data for OpenGL use
+			glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height,
+				0, image_format, GL_UNSIGNED_BYTE, bits);
+
+			//swizzle colors - not needed for stb_image
+			//GLint swizzleMask[] = { GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA };
+			//glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
+
+			if (useMipMaps)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
 
-		//Free stb's copy of the data
-		stbi_image_free(bits);
+			if (haveKey) StoreInCache(filename, cacheKey, bits, width, height, useMipMaps);
+
+			//Free stb's copy of the data
+			stbi_image_free(bits);
+		}
 
 		newtex->width = width;
 		newtex->height = height;
 		
 		//add the new texture to the map
 		textures[filename] = newtex;		
+		SetResidentBytes(newtex, EstimateBytes(width, height, useMipMaps));
 
 		currentId[texture_unit - GL_TEXTURE0] = newtex->texId;
 
-		//setup texture filtering for when we are close/far away
-		if (useMipMaps)
-		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);//when we are far away
-		}
-		else if(pixelate)
-		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
-		}
-		else
-		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
-		}
-
-
-		//the following turns on a special, high-quality filtering mode called "ANISOTROPY"
-		if(GL_EXT_texture_filter_anisotropic)
-		{
-			GLfloat largest_supported_anisotropy;
-			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &largest_supported_anisotropy);
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, largest_supported_anisotropy);
-		}
-
-		// the texture stops at the edges with GL_CLAMP_TO_EDGE
-		//...experiment with GL_CLAMP and GL_REPEAT as well
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapflag );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapflag );
+		SetTextureParameters(useMipMaps, wrapflag, pixelate);
+		TrimToBudget();
 		
 		//return the loaded texture object
-		return newtex->texId;
+		return newtex;
 	}
 	
-	//if we get here in the code, we already had that texture loaded by some other object
+	//if we get here in the code, we already had that texture loaded by some other object, or it was idle
+	loadHits++;
+	if((*itor->second).idle) Revive(itor->second);
 	(*itor->second).refcount++; //update the reference counter
+
+	//an async load of the same file is still in flight: the caller wants the real image and its size now,
+	//not the placeholder, so finish that load first
+	if((*itor->second).pending)
+	{
+		TextureLoadGroup group;
+		group.pending = 1;
+		itor->second->pending->groups.push_back(&group);
+		WaitForLoads(group);
+
+		//WaitForLoads() gave up, don't leave the load pointing at our stack
+		AsyncTextureLoad *load = itor->second->pending;
+		if(load) load->groups.erase(std::remove(load->groups.begin(), load->groups.end(), &group), load->groups.end());
+	}
+
 	//bind it to the texture unit
 	BindTexture((*itor->second).texId, texture_unit);
-	return (*itor->second).texId;//and return the OpenGL texture object ID associated with that texture
+	return itor->second;//and return the texture object associated with that texture
 
 ERROR_HANDLER:
 	oLog(Level::Severe) << "ERROR loading file: " << filename;
 	assert(false && "ERROR loading file");
-	return 0;
+	return NULL;
 }
 
-void TextureManager::FreeTexture(std::string filename)
+void TextureManager::SetTextureParameters(bool useMipMaps, GLuint wrapflag, bool pixelate)
 {
-	itor = textures.find(filename); //lookup this texture in our std::map
+	//setup texture filtering for when we are close/far away
+	if (useMipMaps)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);//when we are far away
+	}
+	else if(pixelate)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //for when we are close
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+	}
+	else
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+	}
 
-	if(itor != textures.end())
+
+	//the following turns on a special, high-quality filtering mode called "ANISOTROPY"
+	if(GL_EXT_texture_filter_anisotropic)
 	{
-		(*itor->second).refcount--; //update the refcount
-		if((*itor->second).refcount <= 0 && (*itor->second).unload)
-		{
-			//we have freed the last refernce, so we can delete this texture from memory
-			glDeleteTextures(1, &(*itor->second).texId);
+		GLfloat largest_supported_anisotropy;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &largest_supported_anisotropy);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, largest_supported_anisotropy);
+	}
+
+	// the texture stops at the edges with GL_CLAMP_TO_EDGE
+	//...experiment with GL_CLAMP and GL_REPEAT as well
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapflag );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapflag );
+}
+
+void TextureManager::FreeTexture(const std::string &filename)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(filename); //lookup this texture in our std::map
+
+	if(itor != textures.end() && !(*itor->second).idle) Release(itor->second);
+	else oLog(Level::Warning) << "Tried to free texture " << filename << " but it isn't loaded currently";
+}
 
-			//if this was the currently bound texture, set currentId to a bad ID value
-			//that won't be matched by the next call to BindTexture()
-			for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
-				if (currentId[i] == (*itor->second).texId) currentId[i] = -1;
+void TextureManager::FreeTexture(TextureHandle handle)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = Lookup(handle, "FreeTexture");
+	if(t == NULL) return;
 
-			delete (itor)->second; //free the instance of a tex struct
-			//clear the texture from the std::unordered_map
-			textures.erase(itor);
+	if(!t->idle) Release(t);
+	else oLog(Level::Warning) << "Tried to free texture " << t->name << " but nothing holds it any more";
+}
+
+void TextureManager::Release(tex *t)
+{
+	t->refcount--; //update the refcount
+	if(t->refcount <= 0 && t->unload)
+	{
+		if(textureBudget > 0 && t->fromFile)
+		{
+			//keep it on the GPU in case it's wanted again soon, until the budget needs the room
+			t->idle = true;
+			lru.push_front(t);
+			t->lruEntry = lru.begin();
+			idleBytes += t->bytes;
+			TrimToBudget();
 		}
+		else DeleteTexture(t); //we have freed the last refernce, so we can delete this texture from memory
 	}
-	else oLog(Level::Warning) << "Tried to free texture " << filename << " but it isn't loaded currently";
+}
+
+tex *TextureManager::Lookup(TextureHandle handle, const char *caller)
+{
+	tex *t = texturePool.Get(handle);
+	if(t == NULL) oLog(Level::Warning) << caller << "(): stale texture handle (slot " << handle.index << ", generation " << handle.generation << ")";
+	return t;
+}
+
+void TextureManager::DeleteTexture(tex *t)
+{
+	//only the GL thread may call GL, anyone else leaves the id for ProcessUploads()
+	if(std::this_thread::get_id() == glThread)
+	{
+		glDeleteTextures(1, &t->texId);
+
+		//if this was the currently bound texture, set currentId to a bad ID value
+		//that won't be matched by the next call to BindTexture()
+		for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
+			if (currentId[i] == t->texId) currentId[i] = -1;
+	}
+	else deadIds.push_back(t->texId);
+
+	if(t->idle)
+	{
+		lru.erase(t->lruEntry);
+		idleBytes -= t->bytes;
+	}
+	residentBytes -= t->bytes;
+
+	//clear the texture from the std::unordered_map
+	textures.erase(t->name);
+	//free the tex; its handles go stale, so a worker still decoding it has its result thrown away
+	texturePool.Destroy(t);
+}
+
+void TextureManager::SetResidentBytes(tex *t, size_t bytes)
+{
+	residentBytes = residentBytes - t->bytes + bytes;
+	if(t->idle) idleBytes = idleBytes - t->bytes + bytes;
+	t->bytes = bytes;
+}
+
+void TextureManager::Revive(tex *t)
+{
+	assert(t->idle && t->refcount == 0);
+	lru.erase(t->lruEntry);
+	idleBytes -= t->bytes;
+	t->idle = false;
+	revivals++;
+}
+
+void TextureManager::TrimToBudget(void)
+{
+	while(!lru.empty() && residentBytes > textureBudget)
+	{
+		tex *t = lru.back();
+
+		evictions++;
+		evictedBytes += t->bytes;
+		oLog(Level::Info) << "Evicted texture " << t->name << " (" << t->bytes << " bytes)";
+		DeleteTexture(t);
+	}
+}
+
+void TextureManager::SetTextureBudget(size_t bytes)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	textureBudget = bytes;
+	oLog(Level::Info) << "Texture budget: " << bytes / (1024 * 1024) << " MB" << (bytes == 0 ? " (idle textures are deleted at once)" : "");
+	TrimToBudget();
+}
+
+float TextureManager::HitRate(void)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	unsigned long long loads = loadHits + loadMisses;
+	return loads > 0 ? (float)((double)loadHits / loads) : 0.f;
+}
+
+void TextureManager::LogResidency(void)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	oLog(Level::Info) << "Textures: " << texturePool.Size() << " resident (" << residentBytes << " bytes), " << lru.size() << " idle ("
+		<< idleBytes << " bytes), budget " << textureBudget << " bytes";
+	oLog(Level::Info) << "Texture loads: " << loadHits << " hits (" << revivals << " revived from the LRU list), " << loadMisses
+		<< " misses, hit rate " << HitRate() * 100.f << "%, " << evictions << " evictions (" << evictedBytes << " bytes)";
 }
 
 void TextureManager::BindTexture(GLuint bindId, GLuint texture_unit)
@@ -205,17 +550,30 @@ void TextureManager::BindTexture(GLuint bindId, GLuint texture_unit)
 	}
 }
 
-void TextureManager::BindTexture(std::string filename, GLuint texture_unit)
+void TextureManager::BindTexture(TextureHandle handle, GLuint texture_unit)
 {
-	itor = textures.find(filename); //lookup this texture in our std::unordered_map
+	GLuint bindId;
+	{
+		std::lock_guard<std::recursive_mutex> lock(texMutex);
+		tex *t = Lookup(handle, "BindTexture");
+		if(t == NULL) return;
+		bindId = t->texId;
+	}
+	BindTexture(bindId, texture_unit);
+}
+
+void TextureManager::BindTexture(const std::string &filename, GLuint texture_unit)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(filename); //lookup this texture in our std::unordered_map
 
-	if (itor != textures.end())
+	if (itor != textures.end() && !(*itor->second).idle)
 	{
 		BindTexture((*itor->second).texId, texture_unit);
 		return;
 	}
 
-	//didn't find it in the list of loaded textures, so load it.
+	//didn't find it (or nobody holds it) in the list of loaded textures, so load it.
 	//LoadTexture() binds it when it loads.
 	LoadTexture(filename, true, GL_CLAMP_TO_EDGE, texture_unit);
 }
@@ -225,30 +583,103 @@ void TextureManager::InitShaderVar(GLSLProgram *the_shader, const char *samplerN
 	the_shader->setUniform(samplerName, shaderVar);
 }
 
-void TextureManager::AddLoadedTexture(std::string name, GLuint bindId)
+TextureHandle TextureManager::AddLoadedTexture(const std::string &name, GLuint bindId)
 {
-	itor = textures.find(name); //lookup this texture in our std::map
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(name); //lookup this texture in our std::map
 
 	if (itor == textures.end())
 	{
-		tex *newtex = new tex;
+		tex *newtex = texturePool.Create();
+		newtex->name = name;
 
 		newtex->refcount = 1;
 		newtex->unload = true; //currently setting all textures to unload when refcount = 0;
+		newtex->pending = NULL;
+		newtex->width = newtex->height = 0;
 
 		newtex->texId = bindId;
 		textures[name] = newtex;
+		return texturePool.HandleOf(newtex);
 	}
 	else
 	{
 		//update the ref count
+		if((*itor->second).idle) Revive(itor->second);
 		(*itor->second).refcount++; //update the reference counter
+		return texturePool.HandleOf(itor->second);
 	}
 }
 
-bool TextureManager::FetchDimensions(std::string name, GLfloat &width, GLfloat &height)
+TextureHandle TextureManager::CreateTexture(const std::string &name, const BYTE *rgba, int width, int height, bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	if (textures.find(name) != textures.end())
+	{
+		oLog(Level::Severe) << "CreateTexture(): a texture called " << name << " already exists";
+		return TextureHandle();
+	}
+
+	tex *newtex = texturePool.Create();
+	newtex->name = name;
+	newtex->refcount = 1;
+	newtex->unload = true;
+	newtex->pending = NULL;
+	newtex->width = width;
+	newtex->height = height;
+
+	glGenTextures(1, &newtex->texId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, newtex->texId);
+	currentId[0] = newtex->texId;
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	if (useMipMaps) glGenerateMipmap(GL_TEXTURE_2D);
+	SetTextureParameters(useMipMaps, wrapflag, pixelate);
+
+	textures[name] = newtex;
+	SetResidentBytes(newtex, EstimateBytes(width, height, useMipMaps));
+	TrimToBudget();
+	return texturePool.HandleOf(newtex);
+}
+
+TextureHandle TextureManager::Resolve(const std::string &name)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(name);
+	if(itor == textures.end()) return TextureHandle();
+	return texturePool.HandleOf(itor->second);
+}
+
+std::string TextureManager::NameOf(TextureHandle handle)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = Lookup(handle, "NameOf");
+	return t ? t->name : std::string();
+}
+
+GLuint TextureManager::TextureId(TextureHandle handle)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = Lookup(handle, "TextureId");
+	return t ? t->texId : 0;
+}
+
+bool TextureManager::FetchDimensions(TextureHandle handle, GLfloat &width, GLfloat &height)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = Lookup(handle, "FetchDimensions");
+	if(t == NULL) return false;
+
+	width = static_cast<float>(t->width);
+	height = static_cast<float>(t->height);
+	return true;
+}
+
+bool TextureManager::FetchDimensions(const std::string &name, GLfloat &width, GLfloat &height)
 {
-	itor = textures.find(name); //lookup this texture in our std::map
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(name); //lookup this texture in our std::map
 
 	if(itor != textures.end())
 	{
@@ -260,4 +691,303 @@ bool TextureManager::FetchDimensions(std::string name, GLfloat &width, GLfloat &
 	//didn't find it in the list of loaded textures
 	oLog(Level::Warning) << "File: " << name << "is not loaded, so cannot fetch dimensions";
 	return false;
-}
\ No newline at end of file
+}
+
+void TextureManager::SetThreadPool(ThreadPool *pool)
+{
+	loaderPool = pool;
+}
+
+GLuint TextureManager::LoadTextureAsync(const std::string &filename, TextureLoadCallback callback, TextureLoadGroup *group,
+	bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	return LoadAsyncInternal(filename, callback, group, useMipMaps, wrapflag, pixelate)->texId;
+}
+
+TextureHandle TextureManager::LoadAsync(const std::string &filename, TextureLoadCallback callback, TextureLoadGroup *group,
+	bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	return texturePool.HandleOf(LoadAsyncInternal(filename, callback, group, useMipMaps, wrapflag, pixelate));
+}
+
+tex *TextureManager::LoadAsyncInternal(const std::string &filename, TextureLoadCallback callback, TextureLoadGroup *group,
+	bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	assert(loaderPool != NULL && "LoadTextureAsync() needs SetThreadPool() first");
+
+	auto itor = textures.find(filename);
+	if(itor != textures.end())
+	{
+		tex *existing = itor->second;
+		loadHits++;
+		if(existing->idle) Revive(existing);
+		existing->refcount++;
+
+		if(existing->pending)
+		{
+			//join the load already in flight
+			if(callback) existing->pending->callbacks.push_back(callback);
+			if(group)
+			{
+				group->pending++;
+				existing->pending->groups.push_back(group);
+			}
+		}
+		else if(callback) callback(filename, existing->texId, true);
+
+		return existing;
+	}
+
+	tex *newtex = texturePool.Create();
+	newtex->name = filename;
+	newtex->refcount = 1;
+	newtex->unload = true;
+	newtex->width = newtex->height = 0;
+	newtex->fromFile = true;
+	loadMisses++;
+
+	//the id is final, only its image changes when the load finishes
+	glGenTextures(1, &newtex->texId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, newtex->texId);
+	currentId[0] = newtex->texId;
+
+	GLubyte placeholder[4] = { 0, 0, 0, 0 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	AsyncTextureLoad *load = new AsyncTextureLoad;
+	load->filename = filename;
+	load->texId = newtex->texId;
+	load->handle = texturePool.HandleOf(newtex);
+	load->useMipMaps = useMipMaps;
+	load->wrapflag = wrapflag;
+	load->pixelate = pixelate;
+	if(callback) load->callbacks.push_back(callback);
+	if(group)
+	{
+		group->pending++;
+		load->groups.push_back(group);
+	}
+	load->logTiming = false;
+	load->bits = NULL;
+	load->cached = NULL;
+	load->compressed = NULL;
+	load->haveKey = false;
+	load->cacheKey = 0;
+	load->width = load->height = 0;
+	load->decodeMs = 0.0;
+
+	newtex->pending = load;
+	textures[filename] = newtex;
+	SetResidentBytes(newtex, 4); //the placeholder
+
+	{
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		decodesInFlight++;
+	}
+
+	//the worker only reads the file and decodes, the GL work waits for ProcessUploads()
+	loaderPool->Submit([this, load]()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		if(B3D::IsCompressedTextureFile(load->filename))
+		{
+			load->compressed = new B3D::CompressedImage();
+			if(B3D::ReadCompressedTexture(load->filename, *load->compressed))
+			{
+				load->width = load->compressed->width;
+				load->height = load->compressed->height;
+			}
+			else
+			{
+				delete load->compressed;
+				load->compressed = NULL;
+			}
+		}
+		else load->bits = DecodeImage(load->filename, load->width, load->height, load->cached, load->cacheKey, load->haveKey);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		load->decodeMs = elapsed.count();
+
+		//write the cache file here rather than on the GL thread; level 0 only, a hit regenerates the mips
+		if(load->bits != NULL && load->haveKey) StoreInCache(load->filename, load->cacheKey, load->bits, load->width, load->height, false);
+
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		decoded.push_back(load);
+		decodesInFlight--;
+		decodeFinished.notify_all();
+	});
+
+	return newtex;
+}
+
+void TextureManager::FinishLoad(AsyncTextureLoad *load)
+{
+	bool ok = (load->bits != NULL || load->cached != NULL || load->compressed != NULL) && load->width > 0 && load->height > 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::recursive_mutex> lock(texMutex);
+
+	//a stale handle means the texture was freed before the load finished
+	tex *target = texturePool.Get(load->handle);
+	if(target == NULL)
+	{
+		ok = false;
+	}
+	else
+	{
+		target->pending = NULL;
+
+		if(ok)
+		{
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, load->texId);
+			currentId[0] = load->texId;
+
+			bool mipmapped = load->useMipMaps;
+			size_t bytes = EstimateBytes(load->width, load->height, load->useMipMaps);
+			if(load->compressed) ok = UploadCompressed(load->filename, *load->compressed, load->useMipMaps, mipmapped, bytes);
+			else if(load->cached) UploadCached(load->cached, load->useMipMaps);
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, load->width, load->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, load->bits);
+				if(load->useMipMaps) glGenerateMipmap(GL_TEXTURE_2D);
+			}
+
+			if(ok)
+			{
+				SetTextureParameters(mipmapped, load->wrapflag, load->pixelate);
+				target->width = load->width;
+				target->height = load->height;
+				SetResidentBytes(target, bytes);
+			}
+		}
+
+		if(!ok) oLog(Level::Severe) << "ERROR loading file: " << load->filename << " (async), keeping the placeholder";
+	}
+
+	if(load->bits) stbi_image_free(load->bits);
+	if(load->cached) delete load->cached;
+	if(load->compressed) delete load->compressed;
+
+	std::chrono::duration<double, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - start;
+	if(load->logTiming && ok)
+	{
+		oLog(Level::Info) << "Loaded " << load->filename << " (" << load->width << "x" << load->height << "): decode "
+			<< load->decodeMs << " ms, upload " << uploadTime.count() << " ms";
+	}
+
+	for(TextureLoadGroup *group : load->groups)
+	{
+		group->pending--;
+		if(!ok) group->failed++;
+		group->decodeMs += load->decodeMs;
+		group->uploadMs += uploadTime.count();
+	}
+
+	//the callbacks may well load more, or wait on other threads
+	lock.unlock();
+	for(TextureLoadCallback &callback : load->callbacks) callback(load->filename, load->texId, ok);
+	delete load;
+
+	//the real image is bigger than its placeholder
+	lock.lock();
+	TrimToBudget();
+}
+
+void TextureManager::ProcessUploads(double budgetMs)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	{
+		std::lock_guard<std::recursive_mutex> lock(texMutex);
+		if(!deadIds.empty())
+		{
+			glDeleteTextures((GLsizei)deadIds.size(), deadIds.data());
+			for(GLuint id : deadIds)
+			{
+				for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
+					if (currentId[i] == id) currentId[i] = -1;
+			}
+			deadIds.clear();
+		}
+	}
+
+	for(;;)
+	{
+		AsyncTextureLoad *load;
+		{
+			std::lock_guard<std::mutex> lock(asyncMutex);
+			if(decoded.empty()) return;
+			load = decoded.front();
+			decoded.pop_front();
+		}
+
+		FinishLoad(load);
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if(elapsed.count() >= budgetMs) return;
+	}
+}
+
+void TextureManager::WaitForLoads(TextureLoadGroup &group)
+{
+	while(group.pending > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(asyncMutex);
+			decodeFinished.wait(lock, [this] { return !decoded.empty() || decodesInFlight == 0; });
+		}
+
+		ProcessUploads(1e30);
+
+		//nothing left anywhere, yet the group still waits: it was counted by a load that never started
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		if(group.pending > 0 && decoded.empty() && decodesInFlight == 0)
+		{
+			oLog(Level::Warning) << "WaitForLoads() gave up on " << group.pending << " loads that aren't in flight";
+			return;
+		}
+	}
+}
+
+bool TextureManager::IsTextureReady(TextureHandle handle)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	tex *t = Lookup(handle, "IsTextureReady");
+	return t != NULL && t->pending == NULL;
+}
+
+bool TextureManager::IsTextureReady(const std::string &filename)
+{
+	std::lock_guard<std::recursive_mutex> lock(texMutex);
+	auto itor = textures.find(filename);
+	return itor != textures.end() && itor->second->pending == NULL;
+}
+
+bool TextureManager::Preload(const std::vector<std::string> &filenames, bool useMipMaps, GLuint wrapflag, bool pixelate)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	TextureLoadGroup group;
+	{
+		std::lock_guard<std::recursive_mutex> lock(texMutex);
+		for(const std::string &filename : filenames)
+		{
+			bool alreadyKnown = textures.find(filename) != textures.end();
+			tex *t = LoadAsyncInternal(filename, nullptr, &group, useMipMaps, wrapflag, pixelate);
+			if(!alreadyKnown) t->pending->logTiming = true;
+		}
+	}
+
+	WaitForLoads(group);
+
+	std::chrono::duration<double, std::milli> wallTime = std::chrono::high_resolution_clock::now() - start;
+	oLog(Level::Info) << "Preloaded " << filenames.size() << " textures in " << wallTime.count() << " ms wall time on "
+		<< loaderPool->ThreadCount() << " workers (decode " << group.decodeMs << " ms summed, upload " << group.uploadMs << " ms)"
+		<< (group.failed ? ", FAILED: " : "") << (group.failed ? std::to_string(group.failed) : "");
+
+	return group.failed == 0;
+}
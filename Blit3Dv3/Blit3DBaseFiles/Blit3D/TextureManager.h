@@ -6,6 +6,17 @@ texture binding state management.
 
 Now uses the excellent stb_image library as it's image loader.
 
+Version 3.8, textures live in a HandlePool and loads hand out TextureHandles (index + generation), which every
+	call accepts, so per-object paths don't hash names; the name table is only used to resolve names. Guarded
+	by a mutex instead of sharing an iterator, and a last reference freed off the GL thread is deleted later
+Version 3.7, optional VRAM budget: textures loaded from files stay on the GPU after their last reference
+	is freed, in an LRU list, and are only deleted when the budget needs the room (SetTextureBudget())
+Version 3.6, loads GPU-compressed DDS, KTX and KTX2 files (BC1-BC7, see CompressedTexture.h) with all their mip levels
+Version 3.5, added CreateTexture() for images made in memory, like atlas pages
+Version 3.4, optional on-disk cache of decoded images (see TextureCache.h), turned on with SetCacheDirectory()
+Version 3.3, added Preload(), which decodes a list of files in parallel and logs how long each one took
+Version 3.2, added LoadTextureAsync(): files are read and decoded on the thread pool, the texture id is
+	returned at once with a placeholder image, and ProcessUploads() swaps the real image in on the GL thread
 Version 3.1, get stb to flip imges as it loads them so that they are right-side up in OpenGL
 Version 3.0, uses stb_image instead of FreeImage (no more fake memory leaks etc)
 Version 2.3, uses GLEW on all platforms for now
@@ -36,7 +47,20 @@ Version 1.4, added AddLoadedTexture() to let FBO add textures to the TM
 
 #include <unordered_map>
 #include <algorithm>
+#include <vector>
+#include <deque>
+#include <list>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 #include "glslprogram.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "CompressedTexture.h"
+#include "HandlePool.h"
+#include <thread>
+
+class AsyncTextureLoad;
 
 struct tex
 {
@@ -44,7 +68,58 @@ public:
 	GLuint texId; //opengl texture object id
 	GLuint refcount; //reference counter...how many objects are using this texture
 	bool unload; //do we unload this texture and free it's id when the refcount is 0?
+	int width, height; //0 while an async load is pending
+	AsyncTextureLoad *pending; //NULL once the real image is on the GPU
+	std::string name; //its key in the name table
+	size_t bytes = 0; //estimated GPU memory, 0 for textures we didn't create (FBOs)
+	bool fromFile = false; //only these can be reloaded, so only these are kept around unreferenced
+	bool idle = false; //refcount is 0 and it waits in the LRU list for a reuse or an eviction
+	std::list<tex *>::iterator lruEntry;
+};
+
+//a texture in the TextureManager: a slot index plus the generation it was issued for, so using one is an array
+//lookup, and a handle to a texture that has since been deleted is caught instead of reaching whatever reuses
+//the slot. A default-constructed handle is always stale
+typedef B3D::Handle<tex> TextureHandle;
+
+//called on the GL thread once an async load is finished; ok is false if the file couldn't be read,
+//in which case the texture keeps its placeholder image
+typedef std::function<void(const std::string &filename, GLuint texId, bool ok)> TextureLoadCallback;
+
+//counts the async loads started with it, so you can wait for a level's worth of textures at once.
+//Only touch it from the GL thread
+class TextureLoadGroup
+{
+public:
+	int pending = 0; //loads not uploaded yet
+	int failed = 0; //loads that couldn't be decoded
+	double decodeMs = 0.0; //summed over the group's loads, across all workers
+	double uploadMs = 0.0; //summed, all on the GL thread
+
+	bool Done(void) { return pending == 0; }
+};
+
+//one async load in flight: the worker fills in bits/width/height, the GL thread uploads
+class AsyncTextureLoad
+{
+public:
+	std::string filename;
+	GLuint texId;
+	TextureHandle handle;
+	bool useMipMaps;
+	GLuint wrapflag;
+	bool pixelate;
+	std::vector<TextureLoadCallback> callbacks;
+	std::vector<TextureLoadGroup *> groups;
+	bool logTiming; //log the decode and upload times when it's finished
+
+	BYTE *bits; //decoded, or
+	TextureCacheEntry *cached; //a cache hit, no decoding needed, or
+	B3D::CompressedImage *compressed; //a DDS/KTX file, uploaded as it is
+	bool haveKey; //cacheKey is valid, so a decoded image can be stored in the cache
+	uint64_t cacheKey;
 	int width, height;
+	double decodeMs; //file read and decode, on the worker
 };
 
 //the maximum texture units OpenGL supports
@@ -54,24 +129,119 @@ public:
 class TextureManager
 {
 private:
-	std::unordered_map<std::string, tex *> textures; //list of textures and associated id's, in a hashmap
-	GLuint currentId[TEXTURE_MANAGER_MAX_TEXTURES]; //currently bound texture
-	std::unordered_map<std::string, tex *>::iterator itor; //might as well save an iterator to use on our map
+	B3D::HandlePool<tex> texturePool; //the textures themselves, TextureHandles index straight into it
+	std::unordered_map<std::string, tex *> textures; //name table: only loading and resolving by name hash
+	//guards the pool, the name table, the LRU list and the stats. Recursive, as BindTexture(name) loads and
+	//Preload() waits on loads
+	std::recursive_mutex texMutex;
+	GLuint currentId[TEXTURE_MANAGER_MAX_TEXTURES]; //currently bound texture; GL thread only, no lock
+	std::thread::id glThread; //the thread that made us, which owns the GL context
+	std::vector<GLuint> deadIds; //freed off the GL thread, deleted by the next ProcessUploads()
+
+	//async loading: workers only ever touch decoded and decodesInFlight, under asyncMutex
+	ThreadPool *loaderPool;
+	std::mutex asyncMutex;
+	std::condition_variable decodeFinished;
+	std::deque<AsyncTextureLoad *> decoded; //ready to upload, oldest first
+	int decodesInFlight;
+
+	//VRAM budget: idle textures, most recently freed at the front; evicted from the back
+	std::list<tex *> lru;
+	size_t textureBudget; //0 means idle textures are deleted at once
+
+	void SetResidentBytes(tex *t, size_t bytes);
+	void Revive(tex *t); //an idle texture is wanted again: off the LRU list
+	void DeleteTexture(tex *t); //GL texture and bookkeeping
+	void Release(tex *t); //drops a reference; the last one makes it idle or deletes it
+	tex *Lookup(TextureHandle handle, const char *caller); //NULL and a warning if the handle is stale
+	tex *LoadInternal(const std::string &filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate);
+	tex *LoadAsyncInternal(const std::string &filename, TextureLoadCallback callback, TextureLoadGroup *group,
+		bool useMipMaps, GLuint wrapflag, bool pixelate);
+	void TrimToBudget(void); //evicts idle textures, oldest first, until we are within the budget
+
+	void SetTextureParameters(bool useMipMaps, GLuint wrapflag, bool pixelate); //for the texture bound to GL_TEXTURE_2D
+	//reads an image from the cache, or decodes it; no GL calls, so the workers use it too
+	BYTE *DecodeImage(const std::string &filename, int &width, int &height, TextureCacheEntry *&cached, uint64_t &cacheKey, bool &haveKey);
+	void UploadCached(TextureCacheEntry *cached, bool useMipMaps); //into the texture bound to GL_TEXTURE_2D
+	//with useMipMaps it reads the mips back from the bound texture, so GL thread only; without, safe from any thread
+	void StoreInCache(const std::string &filename, uint64_t cacheKey, BYTE *bits, int width, int height, bool useMipMaps);
+	//every stored level of a compressed image into the texture bound to GL_TEXTURE_2D, decoding on the CPU if the
+	//driver lacks the format; mipmapped says which filtering the texture can use. false if it can't be uploaded at all
+	bool UploadCompressed(const std::string &filename, const B3D::CompressedImage &image, bool useMipMaps, bool &mipmapped, size_t &bytes);
+	void FinishLoad(AsyncTextureLoad *load); //upload, run callbacks, update groups; GL thread only
 	
 public:
+	double uploadBudgetMs; //time ProcessUploads() may spend per frame, at least one texture is always uploaded
+	TextureCache cache; //decoded images on disk, off until SetCacheDirectory()
+
+	//residency stats, updated under texMutex
+	size_t residentBytes; //every texture we know the size of, referenced or idle
+	size_t idleBytes; //the part of residentBytes in the LRU list
+	unsigned long long loadHits; //LoadTexture()/LoadTextureAsync() found it already on the GPU
+	unsigned long long loadMisses; //had to read the file
+	unsigned long long revivals; //hits that came back from the LRU list, a reload saved
+	unsigned long long evictions;
+	size_t evictedBytes;
+
 	std::string texturePath; //relative path to the files
 
 	int texureLocation; // Store the location of our texture sampler in the shader
 
 	void InitShaderVar(GLSLProgram *the_shader, const char * samplerName, int shaderVar = 0); //initalizes the shader variable for the sampler
 
-	GLuint LoadTexture(std::string filename, bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
-	void FreeTexture(std::string filename); 
+	//Handles. Each load returns one and adds a reference, which FreeTexture(handle) drops. Lookups, references
+	//and stats are safe from any thread; whatever calls GL (loading, binding) belongs on the GL thread
+	TextureHandle Load(const std::string &filename, bool useMipMaps = false, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	TextureHandle LoadAsync(const std::string &filename, TextureLoadCallback callback = nullptr, TextureLoadGroup *group = NULL,
+		bool useMipMaps = false, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	TextureHandle Resolve(const std::string &name); //no reference added; a stale handle if it isn't loaded
+	std::string NameOf(TextureHandle handle); //the name it was loaded under, "" (and a warning) if the handle is stale
+	GLuint TextureId(TextureHandle handle); //0 if the handle is stale
+	void FreeTexture(TextureHandle handle);
+	void BindTexture(TextureHandle handle, GLuint texture_unit = GL_TEXTURE0);
+	bool FetchDimensions(TextureHandle handle, GLfloat &width, GLfloat &height);
+	bool IsTextureReady(TextureHandle handle);
+
+	//the same by name, each call hashes the name
+	GLuint LoadTexture(const std::string &filename, bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	void FreeTexture(const std::string &filename);
 	void BindTexture(GLuint bindId, GLuint texture_unit = GL_TEXTURE0);
-	void BindTexture(std::string filename, GLuint texture_unit = GL_TEXTURE0);
+	void BindTexture(const std::string &filename, GLuint texture_unit = GL_TEXTURE0);
 	void SetTexturePath(std::string path);
-	void AddLoadedTexture(std::string name, GLuint bindId);//used by FBO add pre-created textures
-	bool FetchDimensions(std::string name, GLfloat &width, GLfloat &height);
+	void SetCacheDirectory(std::string directory); //"" turns the decoded texture cache off
+	TextureHandle AddLoadedTexture(const std::string &name, GLuint bindId);//used by FBO add pre-created textures
+	//uploads RGBA8 pixels (bottom row first, like stb gives us) as a new texture called name, with one reference.
+	//Returns a stale handle if that name is already taken
+	TextureHandle CreateTexture(const std::string &name, const BYTE *rgba, int width, int height, bool useMipMaps = false,
+		GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	bool FetchDimensions(const std::string &name, GLfloat &width, GLfloat &height);
+
+	//GPU memory (estimated, in bytes) that referenced and idle textures may use together before idle ones are
+	//evicted, least recently used first. Referenced textures are never evicted, so it can be exceeded.
+	//0, the default, deletes textures as soon as their last reference is freed
+	void SetTextureBudget(size_t bytes);
+	size_t TextureBudget(void) { return textureBudget; }
+	float HitRate(void); //fraction of loads that didn't touch the disk
+	void LogResidency(void);
+
+	//async loading. The returned id is valid at once and shows a transparent 1x1 placeholder until the
+	//image has been uploaded, so anything that needs the real dimensions (sprites!) should be made from
+	//the callback, or after WaitForLoads(). Loading a name that is already loaded or pending just adds a reference.
+	//A synchronous LoadTexture()/Load() of a name that is still pending waits for that load to finish.
+	//Call from the GL thread; the decoding happens on the pool given to SetThreadPool() (Blit3D::loaderPool)
+	GLuint LoadTextureAsync(const std::string &filename, TextureLoadCallback callback = nullptr, TextureLoadGroup *group = NULL,
+		bool useMipMaps = false, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	bool IsTextureReady(const std::string &filename);
+	//deletes textures freed off the GL thread, then uploads decoded images until budgetMs is used up;
+	//Blit3D calls it once per frame with uploadBudgetMs
+	void ProcessUploads(double budgetMs);
+	//blocks until every load in the group is uploaded, uploading as they arrive; GL thread only
+	void WaitForLoads(TextureLoadGroup &group);
+	void SetThreadPool(ThreadPool *pool);
+	//loads every file, decoding them in parallel on the thread pool and uploading each as soon as it's ready,
+	//and returns when all are done. Each file gets one reference, like LoadTexture(). Logs every file's decode
+	//time and the totals; returns false if any of them failed
+	bool Preload(const std::vector<std::string> &filenames, bool useMipMaps = false, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
 	TextureManager(void);
 	~TextureManager(void);
 };
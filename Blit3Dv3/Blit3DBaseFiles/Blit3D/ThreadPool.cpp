@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+#include "Logger.h"
+#include <algorithm>
+
+extern logger oLog;
+
+ThreadPool::ThreadPool(int threadCount)
+{
+	outstanding = 0;
+	stopping = false;
+
+	if(threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if(threadCount < 1) threadCount = 1;
+	}
+
+	for(int i = 0; i < threadCount; ++i)
+	{
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+
+	oLog(Level::Info) << "Created ThreadPool with " << threadCount << " worker threads";
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+
+	for(auto &t : workers) t.join();
+}
+
+void ThreadPool::WorkerLoop(void)
+{
+	for(;;)
+	{
+		std::function<void(void)> job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if(jobs.empty()) return; //stopping, and nothing left to do
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			outstanding--;
+			if(outstanding == 0) jobsDone.notify_all();
+		}
+	}
+}
+
+void ThreadPool::Submit(std::function<void(void)> job)
+{
+	{
+		std::unique_lock<std::mutex> lock(jobMutex);
+		jobs.push_back(std::move(job));
+		outstanding++;
+	}
+	jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait(void)
+{
+	std::unique_lock<std::mutex> lock(jobMutex);
+	jobsDone.wait(lock, [this] { return outstanding == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count, std::function<void(size_t, size_t, int)> func)
+{
+	if(count == 0) return;
+
+	int chunks = ThreadCount();
+	size_t chunkSize = (count + chunks - 1) / chunks;
+	chunks = (int)((count + chunkSize - 1) / chunkSize);
+
+	//wait for our own chunks only, other jobs may be running on the pool too
+	std::mutex doneMutex;
+	std::condition_variable doneSignal;
+	int remaining = chunks;
+
+	for(int c = 0; c < chunks; ++c)
+	{
+		size_t begin = c * chunkSize;
+		size_t end = std::min(begin + chunkSize, count);
+
+		Submit([=, &func, &doneMutex, &doneSignal, &remaining]
+		{
+			func(begin, end, c);
+
+			std::unique_lock<std::mutex> lock(doneMutex);
+			remaining--;
+			if(remaining == 0) doneSignal.notify_one();
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneSignal.wait(lock, [&remaining] { return remaining == 0; });
+}
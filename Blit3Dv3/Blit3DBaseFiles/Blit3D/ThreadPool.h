@@ -0,0 +1,50 @@
+#pragma once
+/*
+	Simple worker thread pool.
+
+	Blit3D creates one in Run() (blit3D->threadPool), with one worker per hardware thread,
+	minus one for the thread that owns the OpenGL context. Jobs must never make OpenGL
+	calls: only the thread running Blit3D::Run() may touch GL. Async texture decodes run on a
+	second pool (blit3D->loaderPool), so they never hold up jobs submitted here.
+
+	Example, building sprite batch segments in parallel from Draw():
+
+		blit3D->threadPool->ParallelFor(sprites.size(), [&](size_t begin, size_t end, int worker)
+		{
+			for(size_t i = begin; i < end; ++i) sprites[i]->BlitToSegment(segments[worker], x[i], y[i]);
+		});
+		for(auto seg : segments) blit3D->SubmitBatchSegment(seg);
+*/
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void(void)>> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobAvailable; //signalled when a job is added, or when we shut down
+	std::condition_variable jobsDone; //signalled when the last outstanding job finishes
+	int outstanding; //jobs queued or running
+	bool stopping;
+
+	void WorkerLoop(void);
+
+public:
+	//threadCount <= 0 means one per hardware thread, minus one, but at least one
+	ThreadPool(int threadCount);
+	~ThreadPool(); //finishes the queued jobs, then joins the workers
+
+	void Submit(std::function<void(void)> job);
+	void Wait(void); //blocks until every submitted job has finished, including other people's
+	int ThreadCount(void) { return (int)workers.size(); }
+
+	//splits [0, count) into one chunk per worker, runs func(begin, end, chunkIndex) on each and waits for them.
+	//chunkIndex is in [0, ThreadCount()), handy for indexing per-thread output
+	void ParallelFor(size_t count, std::function<void(size_t, size_t, int)> func);
+};
@@ -0,0 +1,265 @@
+#include "TileMap.h"
+
+extern logger oLog;
+
+TileMap::TileMap(Blit3D *blit3d, std::string tilesetFile, int tileWidthPixels, int tileHeightPixels, int widthInTiles, int heightInTiles, int chunkTiles)
+{
+	assert(tileWidthPixels > 0 && tileHeightPixels > 0);
+	assert(widthInTiles > 0 && heightInTiles > 0);
+	assert(chunkTiles > 0);
+
+	b3d = blit3d;
+	tileWidth = tileWidthPixels;
+	tileHeight = tileHeightPixels;
+	mapWidth = widthInTiles;
+	mapHeight = heightInTiles;
+	chunkSize = chunkTiles;
+	drawCalls = 0;
+	rebuiltChunks = 0;
+
+	//the map starts out in the top-left corner of the screen
+	position = glm::vec2(0.f, (float)b3d->screenHeight);
+
+	textureName = tilesetFile;
+	texHandle = b3d->tManager->Load(tilesetFile);
+	texId = b3d->tManager->TextureId(texHandle);
+	if(texId == 0)
+	{
+		oLog(Level::Severe) << "Image loading error while loading image file: " << tilesetFile << " for TileMap";
+		assert(texId != 0);
+	}
+	b3d->tManager->FetchDimensions(texHandle, textureWidth, textureHeight);
+
+	tilesetColumns = (int)textureWidth / tileWidth;
+	tilesetTiles = tilesetColumns * ((int)textureHeight / tileHeight);
+	assert(tilesetTiles > 0 && "TileMap: tileset texture is smaller than one tile");
+
+	tiles.assign(mapWidth * mapHeight, -1);
+
+	chunksX = (mapWidth + chunkSize - 1) / chunkSize;
+	chunksY = (mapHeight + chunkSize - 1) / chunkSize;
+	chunks.resize(chunksX * chunksY);
+	for(Chunk &chunk : chunks)
+	{
+		glGenVertexArrays(1, &chunk.vaoId);
+		glGenBuffers(1, &chunk.vboId);
+		chunk.quads = 0;
+		chunk.dirty = false; //empty until tiles are set
+	}
+
+	//every chunk uses the same indices: two triangles per quad, same corner order as the SpriteBatch
+	int maxQuads = chunkSize * chunkSize;
+	std::vector<GLuint> indices(maxQuads * 6);
+	for(GLuint i = 0; i < (GLuint)maxQuads; ++i)
+	{
+		indices[i * 6] = i * 4;
+		indices[i * 6 + 1] = i * 4 + 1;
+		indices[i * 6 + 2] = i * 4 + 2;
+		indices[i * 6 + 3] = i * 4 + 2;
+		indices[i * 6 + 4] = i * 4 + 1;
+		indices[i * 6 + 5] = i * 4 + 3;
+	}
+
+	glBindVertexArray(0);
+	glGenBuffers(1, &iboId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	oLog(Level::Info) << "Created TileMap " << mapWidth << "x" << mapHeight << " tiles in " << chunksX * chunksY << " chunks, tileset: " << tilesetFile;
+}
+
+TileMap::~TileMap()
+{
+	for(Chunk &chunk : chunks)
+	{
+		glDeleteBuffers(1, &chunk.vboId);
+		glDeleteVertexArrays(1, &chunk.vaoId);
+	}
+	chunks.clear();
+
+	glDeleteBuffers(1, &iboId);
+
+	b3d->tManager->FreeTexture(texHandle);
+}
+
+void TileMap::SetTile(int x, int y, int tile)
+{
+	assert(x >= 0 && x < mapWidth && y >= 0 && y < mapHeight && "TileMap::SetTile(): outside the map");
+	assert(tile >= -1 && tile < tilesetTiles && "TileMap::SetTile(): no such tile in the tileset");
+
+	int &cell = tiles[y * mapWidth + x];
+	if(cell == tile) return;
+
+	cell = tile;
+	chunks[(y / chunkSize) * chunksX + x / chunkSize].dirty = true;
+}
+
+int TileMap::GetTile(int x, int y)
+{
+	assert(x >= 0 && x < mapWidth && y >= 0 && y < mapHeight && "TileMap::GetTile(): outside the map");
+	return tiles[y * mapWidth + x];
+}
+
+void TileMap::SetTiles(const std::vector<int> &tileIndices)
+{
+	assert(tileIndices.size() == tiles.size() && "TileMap::SetTiles(): wrong number of tiles");
+
+	tiles = tileIndices;
+	for(Chunk &chunk : chunks) chunk.dirty = true;
+}
+
+void TileMap::Fill(int tile)
+{
+	assert(tile >= -1 && tile < tilesetTiles && "TileMap::Fill(): no such tile in the tileset");
+
+	tiles.assign(tiles.size(), tile);
+	for(Chunk &chunk : chunks) chunk.dirty = true;
+}
+
+void TileMap::SetPosition(float x, float y)
+{
+	if(position.x == x && position.y == y) return;
+
+	position = glm::vec2(x, y);
+	for(Chunk &chunk : chunks) chunk.dirty = true;
+}
+
+bool TileMap::WorldToTile(float x, float y, int &tileX, int &tileY)
+{
+	float col = floorf((x - position.x) / tileWidth);
+	float row = floorf((position.y - y) / tileHeight);
+	if(col < 0.f || row < 0.f || col >= (float)mapWidth || row >= (float)mapHeight) return false;
+
+	tileX = (int)col;
+	tileY = (int)row;
+	return true;
+}
+
+void TileMap::Rebuild(int chunkIndex)
+{
+	Chunk &chunk = chunks[chunkIndex];
+	chunk.dirty = false;
+
+	int firstX = (chunkIndex % chunksX) * chunkSize;
+	int firstY = (chunkIndex / chunksX) * chunkSize;
+	int lastX = glm::min(firstX + chunkSize, mapWidth);
+	int lastY = glm::min(firstY + chunkSize, mapHeight);
+
+	std::vector<B3D::BVertex> verts;
+	verts.reserve(chunkSize * chunkSize * 4);
+
+	GLuint white = B3D::PackColor(1.f, 1.f, 1.f, 1.f);
+
+	for(int y = firstY; y < lastY; ++y)
+	{
+		for(int x = firstX; x < lastX; ++x)
+		{
+			int tile = tiles[y * mapWidth + x];
+			if(tile < 0) continue;
+
+			//tile rect in the tileset, same UV convention as SpriteSheet::AddRegion()
+			float u1 = (float)((tile % tilesetColumns) * tileWidth) / textureWidth;
+			float u2 = u1 + (float)tileWidth / textureWidth;
+			float v1 = 1.f - (float)((tile / tilesetColumns) * tileHeight) / textureHeight;
+			float v2 = v1 - (float)tileHeight / textureHeight;
+
+			float left = position.x + (float)(x * tileWidth);
+			float right = left + (float)tileWidth;
+			float top = position.y - (float)(y * tileHeight);
+			float bottom = top - (float)tileHeight;
+
+			size_t first = verts.size();
+			verts.resize(first + 4);
+			B3D::BVertex *quad = &verts[first];
+
+			//top left, bottom left, top right, bottom right
+			quad[0].x = left;	quad[0].y = top;	quad[0].z = 0.f;
+			quad[0].u = u1;	quad[0].v = v1;	quad[0].color = white;
+			quad[1].x = left;	quad[1].y = bottom;	quad[1].z = 0.f;
+			quad[1].u = u1;	quad[1].v = v2;	quad[1].color = white;
+			quad[2].x = right;	quad[2].y = top;	quad[2].z = 0.f;
+			quad[2].u = u2;	quad[2].v = v1;	quad[2].color = white;
+			quad[3].x = right;	quad[3].y = bottom;	quad[3].z = 0.f;
+			quad[3].u = u2;	quad[3].v = v2;	quad[3].color = white;
+		}
+	}
+
+	chunk.quads = (GLsizei)(verts.size() / 4);
+	rebuiltChunks++;
+	if(chunk.quads == 0) return;
+
+	glBindVertexArray(chunk.vaoId);
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk.vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::BVertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
+
+	//same layout as the SpriteBatch, so we can draw with its shader
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(0)); //x,y,z
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(B3D::BVertex), BUFFER_OFFSET(sizeof(GLfloat) * 5)); //color
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2); //don't use channel 2
+	glEnableVertexAttribArray(3); //Color channel carries the tint
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void TileMap::Draw(void)
+{
+	drawCalls = 0;
+	rebuiltChunks = 0;
+
+	//which chunks does the visible rect touch?
+	float left, bottom, right, top;
+	b3d->camera2d->GetVisibleRect(left, bottom, right, top);
+
+	float chunkWidth = (float)(chunkSize * tileWidth);
+	float chunkHeight = (float)(chunkSize * tileHeight);
+
+	int firstX = (int)floorf((left - position.x) / chunkWidth);
+	int lastX = (int)floorf((right - position.x) / chunkWidth);
+	int firstY = (int)floorf((position.y - top) / chunkHeight);
+	int lastY = (int)floorf((position.y - bottom) / chunkHeight);
+
+	firstX = glm::max(firstX, 0);
+	firstY = glm::max(firstY, 0);
+	lastX = glm::min(lastX, chunksX - 1);
+	lastY = glm::min(lastY, chunksY - 1);
+	if(firstX > lastX || firstY > lastY) return; //map is off screen
+
+	//sprites drawn before us go underneath
+	b3d->Flush();
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	GLSLProgram *prog = b3d->shader2dBatch;
+	prog->use(); //the matrices come from the frame uniform block
+
+	b3d->tManager->BindTexture(texId);
+
+	for(int cy = firstY; cy <= lastY; ++cy)
+	{
+		for(int cx = firstX; cx <= lastX; ++cx)
+		{
+			int index = cy * chunksX + cx;
+			if(chunks[index].dirty) Rebuild(index);
+
+			Chunk &chunk = chunks[index];
+			if(chunk.quads == 0) continue;
+
+			glBindVertexArray(chunk.vaoId);
+			glDrawElements(GL_TRIANGLES, chunk.quads * 6, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+			drawCalls++;
+		}
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(previousProgram);
+}
@@ -0,0 +1,77 @@
+#pragma once
+/*
+	Chunked tilemap.
+
+	A grid of tile indices drawn from one tileset texture. Tile index n is the n-th tile of the
+	tileset, counting left to right, top to bottom; -1 leaves the cell empty. Row 0 of the map is
+	the top row, and the map hangs down and to the right of its position.
+
+	The map is split into square chunks of tiles, and each chunk is baked into its own vertex
+	buffer. Draw() only draws the chunks that overlap the visible rect of the view (see
+	Camera2D::GetVisibleRect()), so a frame costs one draw call per visible chunk no matter how
+	big the map is. SetTile() only marks its chunk dirty; dirty chunks are rebuilt the next time
+	they are drawn.
+
+	Create tilemaps with Blit3D::MakeTileMap(), after Init() has started.
+*/
+#include "Blit3D.h"
+#include <vector>
+
+class Blit3D;
+
+class TileMap
+{
+private:
+	class Chunk
+	{
+	public:
+		GLuint vboId;
+		GLuint vaoId;
+		GLsizei quads; //non-empty tiles in the chunk
+		bool dirty;
+	};
+
+	std::vector<int> tiles; //mapWidth * mapHeight tile indices, row by row
+	std::vector<Chunk> chunks; //chunksX * chunksY, row by row
+	int mapWidth, mapHeight; //in tiles
+	int chunkSize; //in tiles
+	int chunksX, chunksY;
+
+	std::string textureName;
+	GLuint texId;
+	TextureHandle texHandle;
+	GLfloat textureWidth, textureHeight;
+	int tileWidth, tileHeight; //in pixels
+	int tilesetColumns, tilesetTiles; //tiles per row in the tileset, and in total
+
+	glm::vec2 position; //world coordinates of the top-left corner of the map
+
+	GLuint iboId; //shared by every chunk, room for a full chunk
+
+	Blit3D *b3d;
+
+	void Rebuild(int chunk);
+
+public:
+	int drawCalls; //chunks drawn by the last Draw()
+	int rebuiltChunks; //chunks rebuilt by the last Draw()
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that
+	TileMap(Blit3D *blit3d, std::string tilesetFile, int tileWidthPixels, int tileHeightPixels, int widthInTiles, int heightInTiles, int chunkTiles);
+	~TileMap();
+
+	void SetTile(int x, int y, int tile);
+	int GetTile(int x, int y);
+	void SetTiles(const std::vector<int> &tileIndices); //replaces the whole map, row by row from the top
+	void Fill(int tile);
+
+	int GetWidth(void) { return mapWidth; }
+	int GetHeight(void) { return mapHeight; }
+
+	void SetPosition(float x, float y); //moves the map; rebuilds every chunk, so don't do it every frame
+	glm::vec2 GetPosition(void) { return position; }
+	//finds the tile under a world position, returns false if it is outside the map
+	bool WorldToTile(float x, float y, int &tileX, int &tileY);
+
+	void Draw(void); //draws the visible chunks, rebuilding any that changed
+};
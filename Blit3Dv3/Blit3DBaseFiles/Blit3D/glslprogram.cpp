@@ -11,8 +11,9 @@ using std::ios;
 using std::ostringstream;
 
 #include <sys/stat.h>
+#include <cstring>
 
-GLSLProgram::GLSLProgram() : handle(0), linked(false) { }
+GLSLProgram::GLSLProgram() : handle(0), linked(false), uniformsIssued(0), uniformsSkipped(0) { }
 
 GLSLProgram::~GLSLProgram()
 {
@@ -162,6 +163,7 @@ bool GLSLProgram::link()
 	else 
 	{
         linked = true;
+		invalidateUniformCache();
         return linked;
     }
 }
@@ -208,7 +210,8 @@ void GLSLProgram::setUniform(const char *name, float x, float y)
 	assert(loc >= 0 && "setUniform failed");
 	if (loc >= 0) 
 	{
-		glUniform2f(loc, x, y);
+		float v[2] = { x, y };
+		if (uniformChanged(loc, v, sizeof(v))) glProgramUniform2f(handle, loc, x, y);
 	}
 }
 
@@ -218,7 +221,8 @@ void GLSLProgram::setUniform( const char *name, float x, float y, float z)
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 ) 
 	{
-        glUniform3f(loc,x,y,z);
+        float v[3] = { x, y, z };
+        if( uniformChanged(loc, v, sizeof(v)) ) glProgramUniform3f(handle, loc, x, y, z);
     }
 }
 
@@ -238,7 +242,7 @@ void GLSLProgram::setUniform( const char *name, const vec4 & v)
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 ) 
 	{
-        glUniform4f(loc,v.x,v.y,v.z,v.w);
+        if( uniformChanged(loc, &v[0], sizeof(vec4)) ) glProgramUniform4f(handle, loc, v.x, v.y, v.z, v.w);
     }
 }
 
@@ -248,7 +252,7 @@ void GLSLProgram::setUniform( const char *name, const mat4 & m)
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 )
     {
-        glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
+        if( uniformChanged(loc, &m[0][0], sizeof(mat4)) ) glProgramUniformMatrix4fv(handle, loc, 1, GL_FALSE, &m[0][0]);
     }
 }
 
@@ -258,7 +262,7 @@ void GLSLProgram::setUniform( const char *name, const mat3 & m)
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 )
     {
-        glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]);
+        if( uniformChanged(loc, &m[0][0], sizeof(mat3)) ) glProgramUniformMatrix3fv(handle, loc, 1, GL_FALSE, &m[0][0]);
     }
 }
 
@@ -268,7 +272,7 @@ void GLSLProgram::setUniform( const char *name, float val )
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 )
     {
-        glUniform1f(loc, val);
+        if( uniformChanged(loc, &val, sizeof(val)) ) glProgramUniform1f(handle, loc, val);
     }
 }
 
@@ -278,7 +282,7 @@ void GLSLProgram::setUniform( const char *name, int val )
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 )
     {
-        glUniform1i(loc, val);
+        if( uniformChanged(loc, &val, sizeof(val)) ) glProgramUniform1i(handle, loc, val);
     }
 }
 
@@ -288,7 +292,8 @@ void GLSLProgram::setUniform( const char *name, bool val )
 	assert(loc >= 0 && "setUniform failed");
     if( loc >= 0 )
     {
-        glUniform1i(loc, val);
+        int i = val;
+        if( uniformChanged(loc, &i, sizeof(i)) ) glProgramUniform1i(handle, loc, i);
     }
 }
 
@@ -339,6 +344,33 @@ void GLSLProgram::printActiveAttribs() {
     free(name);
 }
 
+bool GLSLProgram::uniformChanged(int location, const void *value, size_t bytes)
+{
+	if (location >= (int)shadows.size())
+	{
+		size_t oldSize = shadows.size();
+		shadows.resize(location + 1);
+		for (size_t i = oldSize; i < shadows.size(); ++i) shadows[i].bytes = 0;
+	}
+
+	UniformShadow &shadow = shadows[location];
+	if (shadow.bytes == bytes && memcmp(shadow.value, value, bytes) == 0)
+	{
+		uniformsSkipped++;
+		return false;
+	}
+
+	memcpy(shadow.value, value, bytes);
+	shadow.bytes = bytes;
+	uniformsIssued++;
+	return true;
+}
+
+void GLSLProgram::invalidateUniformCache()
+{
+	for (UniformShadow &shadow : shadows) shadow.bytes = 0;
+}
+
 int GLSLProgram::getUniformLocation(const char * name )
 {
 	//return glGetUniformLocation(handle, name);
@@ -2,6 +2,9 @@
 	by David Wolff.
 	Modified by Darren Reid to suit Blit3D needs.
 
+	Version 1.2 keeps a shadow copy of each uniform and skips uploads that wouldn't change it.
+		Uniforms are now set with glProgramUniform*(), so the program no longer has to be in use
+		to set them. If you call glUniform*() yourself on a program, call invalidateUniformCache().
 	Version 1.1 added support for vec2 uniforms
 	Version 1.0	added a map for uniform/attributes, to cache lookup of locations in shader
 */
@@ -21,6 +24,7 @@ using glm::mat4;
 using glm::mat3;
 
 #include <map>
+#include <vector>
 
 namespace GLSLShader {
     enum GLSLShaderType {
@@ -43,7 +47,21 @@ private:
 	std::map<std::string, int> UniformMap;
 	std::map<std::string, int>::iterator UMapIter;
 
+	//last value sent to each uniform location, indexed by location
+	class UniformShadow
+	{
+	public:
+		unsigned char value[sizeof(mat4)];
+		size_t bytes; //0 until something has been sent
+	};
+	std::vector<UniformShadow> shadows;
+
+	bool uniformChanged(int location, const void *value, size_t bytes); //also updates the shadow and the counters
+
 public:
+	unsigned long long uniformsIssued; //uniform uploads sent to OpenGL
+	unsigned long long uniformsSkipped; //uniform uploads skipped because the value was already there
+
     GLSLProgram();
 	~GLSLProgram();
 
@@ -74,6 +92,11 @@ public:
     void   printActiveUniforms();
     void   printActiveAttribs();
 
+	void   invalidateUniformCache(); //forget the shadow copies, the next setUniform() of each is always sent
+	void   resetUniformStats() { uniformsIssued = uniformsSkipped = 0; }
+
+	bool   hasUniform(const char *name) { return GetUniform(name) >= 0; } //false for names inside uniform blocks
+
 	int GetUniform(const char* name);
 	int GetAttribute(const char* name);
 };